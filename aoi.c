@@ -0,0 +1,9 @@
+/**
+ * author: zhoukk
+ * link: https://github.com/zhoukk/aoi
+ *
+ * Implement of aoi for static and shared library.
+ */
+
+#define AOI_IMPLEMENTATION
+#include "aoi.h"
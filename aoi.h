@@ -78,6 +78,9 @@
 #ifndef _aoi_h_
 #define _aoi_h_
 
+#include <stdint.h>
+#include <stdio.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -90,13 +93,62 @@ extern "C" {
 #define AOI_MAX_AOI_P 16
 #define AOI_MAX_AOI (1<<AOI_MAX_AOI_P)
 
+/**
+ * Fraction bits of coordinate, position and speed keep sub-unit precision
+ * in moving and distance test, 0 for plain integer coordinate.
+ * Coordinate is kept in int with the fraction, so range of coordinate and
+ * radius shrink by 2^AOI_FRAC_BITS, about +-8388608 with 8 bits.
+ */
+#ifndef AOI_FRAC_BITS
+#define AOI_FRAC_BITS 0
+#endif // AOI_FRAC_BITS
+
+/**
+ * Trace time of phases into ring buffer when defined,
+ * 1 for update and trigger, 2 also for relink, scan and merge.
+ */
+#ifndef AOI_TRACE_SIZE
+#define AOI_TRACE_SIZE 4096
+#endif // AOI_TRACE_SIZE
+
+/** Size of change log read by spectators. */
+#ifndef AOI_LOG_SIZE
+#define AOI_LOG_SIZE 4096
+#endif // AOI_LOG_SIZE
+
+/** Size of wobble table over half period. */
+#define AOI_WOBBLE_LUT 256
+
 /** Default aoi list size. */
 #define AOI_DEF_AOI 32
 
+/** Maximum rooms, visibility between rooms is a bitmask. */
+#define AOI_MAX_ROOM 64
+
+/** View shape of object used in trigger. */
+#define AOI_SHAPE_CIRCLE 0
+#define AOI_SHAPE_RECT 1
+#define AOI_SHAPE_ELLIPSE 2
+#define AOI_SHAPE_CONE 3
+
+/** Motion profile of moving object. */
+#define AOI_MOTION_WOBBLE 0 /** Straight line with small lateral wobble */
+#define AOI_MOTION_LINEAR 1 /** Straight line at constant speed */
+#define AOI_MOTION_EASE 2   /** Straight line, speed up then slow down */
+
+/** Flag of grid index. */
+#define AOI_GRID_AUTO 0x01  /** Tune cell size by objects tested per hit */
+#define AOI_GRID_HYBRID 0x02 /** Choose grid or x axis list per tile by cost */
+
 /** Value for event used in trigger. */
 #define AOI_ENTER 0x01      /** Some object into sight */
 #define AOI_LEAVE 0x02      /** Some object out sight */
 
+/** Value for change in change log. */
+#define AOI_CHANGE_ENTER 0x01   /** Object entered */
+#define AOI_CHANGE_MOVE 0x02    /** Object moved or changed room */
+#define AOI_CHANGE_LEAVE 0x03   /** Object left */
+
 struct aoi;
 
 struct aoi_event {
@@ -104,6 +156,38 @@ struct aoi_event {
     int e;      /** Trigger event, AOI_ENTER or AOI_LEAVE */
 };
 
+struct aoi_change {
+    int id;     /** Changed object */
+    int e;      /** AOI_CHANGE_ENTER, AOI_CHANGE_MOVE or AOI_CHANGE_LEAVE */
+};
+
+/** Event cursor of trigger, fields are private. */
+struct aoi_iter {
+    int id;
+    int *o_list;
+    int *n_list;
+    int o_i;
+    int n_i;
+};
+
+struct aoi_arrival {
+    int id;     /** Object arrived at destination */
+    int tick;   /** Tick of arrival, sum of ticks of aoi_update_all */
+};
+
+struct aoi_pair {
+    int a;      /** One object of pair */
+    int b;      /** The other object */
+};
+
+struct aoi_density {
+    int count;  /** Objects in cell */
+    int work;   /** Objects tested in last trigger of objects in cell */
+};
+
+/** Callback of batch trigger, events of object id. */
+typedef void (*aoi_trigger_cb)(void *ud, int id, struct aoi_event *list, int n);
+
 /** Memory size of struct aoi. */
 AOI_API int aoi_memsize(void);
 
@@ -137,6 +221,18 @@ AOI_API void aoi_update(struct aoi *aoi, int id, int tick);
 /** Get current position of the object. */
 AOI_API void aoi_pos(struct aoi *aoi, int id, int *px, int *py);
 
+/** Locate the object to same place with fraction. */
+AOI_API void aoi_locatef(struct aoi *aoi, int id, float x, float y);
+
+/** Start move the object to same place with fraction. */
+AOI_API void aoi_movef(struct aoi *aoi, int id, float x, float y);
+
+/** Set the object speed with fraction. */
+AOI_API void aoi_speedf(struct aoi *aoi, int id, float speed);
+
+/** Get current position of the object with fraction. */
+AOI_API void aoi_posf(struct aoi *aoi, int id, float *px, float *py);
+
 /**
  * Trigger aoi event of the object.
  * enter_r: maximum distance other object in sight
@@ -147,12 +243,230 @@ AOI_API void aoi_pos(struct aoi *aoi, int id, int *px, int *py);
 AOI_API int aoi_trigger(struct aoi *aoi, int id, int enter_r, int leave_r,
                         struct aoi_event **list);
 
+/**
+ * Trigger the object like aoi_trigger, but events come out one by one from
+ * aoi_trigger_next without event list, caller may stop early.
+ * aoi_trigger_end must be called before next trigger of the object, events
+ * not taken yet come out again in next trigger.
+ * Return 0 or -1 if no such object.
+ */
+AOI_API int aoi_trigger_begin(struct aoi *aoi, int id, int enter_r,
+                              int leave_r, struct aoi_iter *it);
+
+/** Next event of trigger, return 0 when no more. */
+AOI_API int aoi_trigger_next(struct aoi *aoi, struct aoi_iter *it,
+                             struct aoi_event *ev);
+
+/** End trigger, keep events not taken for next trigger. */
+AOI_API void aoi_trigger_end(struct aoi *aoi, struct aoi_iter *it);
+
 /** Whether the object is moving. */
 AOI_API int aoi_moving(struct aoi *aoi, int id);
 
 /** Get around objects in sight. */
 AOI_API int aoi_around(struct aoi *aoi, int id, int *list, int n);
 
+/**
+ * Set minimum ticks other object must stay out of sight before leave.
+ * A tick is one call of aoi_trigger for the object, 0 to disable.
+ */
+AOI_API void aoi_dwell(struct aoi *aoi, int id, int tick);
+
+/** Set the room of object, all object in room 0 default. */
+AOI_API void aoi_room(struct aoi *aoi, int id, int room);
+
+/**
+ * Set rooms visible from the room, bit n of mask for room n.
+ * All rooms visible from each other default.
+ */
+AOI_API void aoi_room_mask(struct aoi *aoi, int room, uint64_t mask);
+
+/**
+ * Set view shape of the object, circle default.
+ * w:h is the ratio of width and height of rect or ellipse,
+ * enter_r and leave_r of trigger are the half width of shape.
+ * Shape other than circle, rect or ellipse is ignored, cone by aoi_cone.
+ */
+AOI_API void aoi_shape(struct aoi *aoi, int id, int shape, int w, int h);
+
+/**
+ * Set view cone of the object, facing fx, fy with half angle in radian,
+ * enter_r and leave_r of trigger are the radius of cone.
+ */
+AOI_API void aoi_cone(struct aoi *aoi, int id, float fx, float fy, float angle);
+
+/**
+ * Get objects in view cone of the object,
+ * facing fx, fy with half angle in radian and radius r.
+ */
+AOI_API int aoi_cone_query(struct aoi *aoi, int id, float fx, float fy,
+                           float angle, int r, int *list, int n);
+
+/**
+ * Set trigger radius of the object used in batch trigger,
+ * object with enter_r > 0 is triggered by aoi_trigger_all.
+ */
+AOI_API void aoi_radius(struct aoi *aoi, int id, int enter_r, int leave_r);
+
+/** Update moving status of all objects. */
+AOI_API void aoi_update_all(struct aoi *aoi, int tick);
+
+/**
+ * Objects arrived at destination in last aoi_update_all,
+ * instead of polling aoi_moving of every object.
+ * list: arrivals hold until next aoi_update_all
+ */
+AOI_API int aoi_arrivals(struct aoi *aoi, struct aoi_arrival **list);
+
+/**
+ * Trigger aoi event of all objects with radius,
+ * cb called for each object has event.
+ */
+AOI_API void aoi_trigger_all(struct aoi *aoi, aoi_trigger_cb cb, void *ud);
+
+/**
+ * Trigger aoi event of the object, write events to buf as packed stream,
+ * return size written, 0 if no event, -1 if buf not enough, then nothing
+ * changed and it can be retried with a larger buf.
+ *
+ * Packed stream is groups of events, one group for each object:
+ *   varint: object id, zigzag delta from id of previous group, 0 for first
+ *   varint: (target id - previous target id) << 1 | event, previous target
+ *           id is -1 for first, event bit is 0 for enter and 1 for leave
+ *   byte 0: end of group
+ */
+AOI_API int aoi_trigger_pack(struct aoi *aoi, int id, int enter_r,
+                             int leave_r, unsigned char *buf, int size);
+
+/**
+ * Trigger aoi event of all objects with radius, write packed stream to buf.
+ * cursor start with 0, if buf is full *cursor is set to the object to
+ * continue next call, 0 if all done.
+ * return size written, -1 if buf not enough for one group.
+ */
+AOI_API int aoi_trigger_all_pack(struct aoi *aoi, int *cursor,
+                                 unsigned char *buf, int size);
+
+/**
+ * Dump traced phases in ring buffer as chrome trace format json,
+ * empty if not build with AOI_TRACE.
+ */
+AOI_API void aoi_trace_dump(struct aoi *aoi, FILE *f);
+
+/**
+ * Get density map of w * h cells with cell size from x, y,
+ * object out of map is counted in edge cell.
+ * return objects counted.
+ */
+AOI_API int aoi_density_map(struct aoi *aoi, int x, int y, int cell, int w,
+                            int h, struct aoi_density *out);
+
+/**
+ * Set work budget of trigger, maximum objects tested for one object.
+ * In crowd area view radius shrink to the nearest objects the budget
+ * allowed, objects at same distance in x axis are tested together and may
+ * exceed it, 0 to disable.
+ * While budget set, trigger walk x axis list nearest first instead of
+ * grid, hybrid index or shared scan of group. Spectator and objects seen
+ * from far by aoi_visible are not limited by it.
+ */
+AOI_API void aoi_shed(struct aoi *aoi, int work);
+
+/**
+ * Trigger aoi event of objects with radius in turn until budget used up,
+ * next call continue from the object stopped at.
+ * work: maximum objects tested, 0 for no limit
+ * ns: maximum time in nanosecond, 0 for no limit
+ * return objects triggered, at least one if any.
+ */
+AOI_API int aoi_trigger_budget(struct aoi *aoi, int work, int64_t ns,
+                               aoi_trigger_cb cb, void *ud);
+
+/**
+ * Enable grid index with cell size, trigger test objects in cells around
+ * instead of walking x axis list, 0 to disable.
+ * flag AOI_GRID_AUTO rebuild grid with better cell size when objects tested
+ * per hit drift, rebuild is spread over ticks of aoi_update_all.
+ * flag AOI_GRID_HYBRID choose grid or x axis list for objects in each tile
+ * of AOI_TILE_CELL cells, by cost observed in the tile.
+ */
+AOI_API void aoi_grid(struct aoi *aoi, int cell, int flag);
+
+/**
+ * Join the object to group of leader, members of group share one scan of
+ * objects around, each member get its own events from the shared result.
+ * The shared scan is done again after any object moved.
+ * leader < 0 to leave group, leader leave group dissolve it.
+ */
+AOI_API void aoi_group(struct aoi *aoi, int id, int leader);
+
+/**
+ * Attach the object to parent at offset x, y, it follow parent without
+ * moving and relinking of its own, and is found through parent in trigger.
+ * Locate attached object change its offset, move is ignored.
+ * parent < 0 to detach, object stay at current position.
+ * Only one level, parent can't be attached object.
+ */
+AOI_API void aoi_attach(struct aoi *aoi, int id, int parent, int x, int y);
+
+/**
+ * Set radius the object can be seen from, for large object like building.
+ * Other object see it inside its own radius or inside r, leave radius of
+ * r add difference of leave and enter radius of the other.
+ * Such objects are kept in a small tier tested by every trigger instead of
+ * widening the scan of all, so use it for a few large objects only.
+ * r <= 0 to remove.
+ */
+AOI_API void aoi_visible(struct aoi *aoi, int id, int r);
+
+/**
+ * Make the object a spectator or not, for observer of huge radius like
+ * minimap or GM camera. Trigger of spectator test only objects changed
+ * since its last trigger from a change log, cost is proportional to
+ * changes instead of objects around. It test all objects again when itself
+ * moved, radius or room changed, or it fall behind the log.
+ */
+AOI_API void aoi_spectator(struct aoi *aoi, int id, int on);
+
+/**
+ * Add or remove a reader of change log of enter, leave and move, log is on
+ * while any reader. Return position of log now as cursor of a new reader.
+ */
+AOI_API unsigned aoi_change_log(struct aoi *aoi, int on);
+
+/**
+ * Read at most n changes after cursor and advance it, read after each
+ * update_all to get changes of that tick. Move of object not read yet is
+ * logged once. Return count of changes, -1 if reader fall behind log more
+ * than AOI_LOG_SIZE, cursor set to now and reader should read all again.
+ */
+AOI_API int aoi_changes(struct aoi *aoi, unsigned *cursor,
+                        struct aoi_change *list, int n);
+
+/**
+ * Set motion profile of the object used by following move,
+ * AOI_MOTION_WOBBLE by default.
+ */
+AOI_API void aoi_motion(struct aoi *aoi, int id, int motion);
+
+/**
+ * Move the object by velocity in unit per tick, position is integrated by
+ * aoi_update_all, for input driven movement instead of locate every tick.
+ * It stop destination move, move or attach stop it, locate keep it from
+ * new place. vx and vy 0 to stop. aoi_moving report destination move only.
+ */
+AOI_API void aoi_set_velocity(struct aoi *aoi, int id, float vx, float vy);
+
+/**
+ * Find all pairs of objects within distance r in one sweep of x axis list,
+ * for separation or collision of crowd instead of trigger each object with
+ * a tiny radius. Rooms of pair must be visible to each other, attached
+ * objects are paired too.
+ * Return count of all pairs, at most n are written to list, list is
+ * truncated if more than n.
+ */
+AOI_API int aoi_pairs(struct aoi *aoi, int r, struct aoi_pair *list, int n);
+
 #ifdef __cplusplus
 }
 #endif
@@ -170,6 +484,8 @@ AOI_API int aoi_around(struct aoi *aoi, int id, int *list, int n);
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
+#include <time.h>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
@@ -196,47 +512,339 @@ AOI_API int aoi_around(struct aoi *aoi, int id, int *list, int n);
 
 #define AOI_HASH_ID(id) (id%AOI_MAX_AOI)
 
+/** Buckets of grid index, cells hashed into buckets. */
+#define AOI_GRID_BUCKET_P 12
+#define AOI_GRID_BUCKET (1<<AOI_GRID_BUCKET_P)
+
+/** Triggers between tune of grid cell size. */
+#define AOI_GRID_TUNE 1024
+
+/** Ticks to spread grid rebuild over. */
+#define AOI_GRID_STEP 8
+
+/** Tile of hybrid index, size in cells, tiles hashed into buckets. */
+#define AOI_TILE_CELL 16
+#define AOI_TILE_BUCKET 1024
+
+/**
+ * Try other index of tile after AOI_TILE_TRY queries times ratio of cost,
+ * at most AOI_TILE_WAIT queries.
+ */
+#define AOI_TILE_TRY 128
+#define AOI_TILE_WAIT 8192
+
+/** Convert between coordinate and fixed point with fraction bits. */
+#define AOI_FIX(v) ((v) * (1 << AOI_FRAC_BITS))
+#define AOI_FIXF(v) ((int)lrintf((v) * (float)(1 << AOI_FRAC_BITS)))
+#define AOI_UNFIX(v) ((v) >> AOI_FRAC_BITS)
+#define AOI_UNFIXF(v) ((float)(v) / (float)(1 << AOI_FRAC_BITS))
+
+/** Objects in one chunk of other state, allocated when slot first used. */
+#define AOI_EXT_CHUNK_P 10
+#define AOI_EXT_CHUNK (1<<AOI_EXT_CHUNK_P)
+
+struct aoi_shape {
+    int type;       /* circle, rect, ellipse or cone */
+    int w, h;       /* ratio of width and height */
+    float f[2];     /* facing of cone */
+    float c;        /* cosine of cone half angle */
+};
+
+/**
+ * Object in x axis list walked by trigger of others, fields used by that
+ * walk and by moving first, other state in struct aoi_ext.
+ */
 struct aoi_object {
     int id;
-    int p[2];       /* cur pos in moving */
+    int p[2];       /* cur pos in moving, fixed point */
+    int room;       /* room of object in */
+    struct aoi_object *prev[2];
+    struct aoi_object *next[2];
+    struct aoi_object *child;   /* first attached object */
+    int type;       /* invalid or revert */
+    int speed;      /* object moving speed, fixed point */
+    int *n_list;    /* new version object list around */
+    int *o_list;    /* old version object list around */
     int sp[2];      /* pos when start move */
     int dp[2];      /* move destination */
     float d[2];
-    float e;
+    float e;        /* wobble table step per tick */
+    int motion;     /* motion profile of current move */
     int p_tick;     /* tick after move start */
     int n_tick;     /* tick before move end */
-    int type;       /* invalid or revert */
-    int speed;      /* object moving speed */
-    struct aoi_object *prev[2];
-    struct aoi_object *next[2];
-    int *n_list;    /* new version object list around */
-    int *o_list;    /* old version object list around */
+    struct aoi_object *sibling; /* next attached object of parent */
+};
+
+/**
+ * State of object used by itself or by few features, in side array
+ * indexed as slot, keep struct aoi_object small for walk of x axis list.
+ */
+struct aoi_ext {
+    void *ud;       /* user data */
+    int idx;        /* index in alive list */
+    int vel_idx;    /* index in velocity list add 1, 0 none */
+    int motion;     /* motion profile of following move */
+    int r[2];       /* enter and leave radius of batch trigger */
+    int work;       /* objects tested in last trigger */
+    struct aoi_shape shape; /* view shape */
+    int dwell;      /* ticks out of sight before leave */
+    int t_tick;     /* ticks of trigger */
+    int *h_list[2]; /* object out of sight but holding, id and tick */
+    int g_in;       /* grid in, -1 not in grid */
+    int g_cell[2];  /* cell in grid */
+    struct aoi_object *g_prev;
+    struct aoi_object *g_next;
+    struct aoi_object *leader;  /* leader of group */
+    struct aoi_object *member;  /* next member of group */
+    int *c_list;    /* objects around group, leader only */
+    int c_r;        /* leave radius of c_list */
+    unsigned c_gen; /* version of positions c_list built at */
+    struct aoi_object *parent;  /* attached to */
+    int off[2];     /* offset to parent, fixed point */
+    int vis;        /* radius seen from, fixed point, 0 not large */
+    int v_idx;      /* index in large list */
+    unsigned log_at;    /* last position in change log add 1, 0 none */
+    int spectator;
+    unsigned s_seq;     /* change log read of spectator */
+    int s_key[6];       /* x, y, enter, leave, room, epoch of last trigger */
+};
 
-    void *ud;   /* user data */
+struct aoi_tile {
+    float cost[2];  /* average cost of x axis list and grid */
+    int n;          /* queries in tile since last try */
+    int wait;       /* queries before next try */
+};
+
+struct aoi_grid {
+    int cell;       /* cell size, fixed point */
+    int n;          /* objects in grid */
+    struct aoi_object *bucket[AOI_GRID_BUCKET];
+};
+
+struct aoi_trace {
+    const char *name;
+    int id;
+    int64_t ts;     /* begin time in ns */
+    int64_t dur;    /* duration in ns */
 };
 
 struct aoi {
     int id;
     struct aoi_object slot[AOI_MAX_AOI];    /* all object solt */
+    struct aoi_ext *ext[AOI_MAX_AOI / AOI_EXT_CHUNK];   /* other state of slot */
     struct aoi_object *list[2];             /* object list in x and y axis */
+    uint64_t room[AOI_MAX_ROOM];            /* rooms visible from room */
     struct aoi_event elist[AOI_MAX_AOI];	/* event list hold */
+    struct aoi_object *alive[AOI_MAX_AOI];  /* dense list of objects */
+    int n_alive;
+    struct aoi_arrival *arrive;             /* arrivals of last update_all */
+    int n_arrive;
+    int tick;                               /* ticks of all update_all */
+    struct aoi_object **vel;                /* objects moving by velocity */
+    float (*vel_v)[2];                      /* velocity, fixed point */
+    float (*vel_p)[2];                      /* position with fraction */
+    int n_vel;
+    int shed;                               /* work budget of trigger */
+    int turn;                               /* next object of budget trigger */
+    struct aoi_grid grid[2];                /* grid index and rebuild one */
+    int g_cur;                              /* grid in use, -1 disable */
+    int g_flag;
+    int g_rebuild;                          /* next object to rebuild, -1 not */
+    int64_t g_stat[4];                      /* query, cell, test, hit */
+    int tile;                               /* tile size, fixed point */
+    int attach_r;                           /* maximum offset of attached */
+    int n_attach;                           /* attached objects */
+    unsigned gen;                           /* version of positions */
+    struct aoi_object **large;              /* objects seen from far */
+    int n_large;
+    int n_spectator;
+    struct aoi_change log[AOI_LOG_SIZE];    /* ring buffer of changes */
+    int log_readers;                        /* readers of change log */
+    unsigned log_head;                      /* next position of change log */
+    unsigned log_read;                      /* last position of any reader */
+    int log_epoch;                          /* change of all objects */
+    int *log_list;                          /* changed ids of spectator */
+    struct aoi_tile tiles[AOI_TILE_BUCKET];
+#ifdef AOI_TRACE
+    struct aoi_trace trace[AOI_TRACE_SIZE]; /* ring buffer of trace */
+    unsigned int n_trace;
+#endif
 };
 
+static inline int64_t
+_aoi_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#ifdef AOI_TRACE
+static inline void
+_aoi_trace_push(struct aoi *aoi, int64_t ts, const char *name, int id) {
+    struct aoi_trace *t = &aoi->trace[aoi->n_trace++ % AOI_TRACE_SIZE];
+    t->name = name;
+    t->id = id;
+    t->ts = ts;
+    t->dur = _aoi_now() - ts;
+}
+
+#define AOI_TRACE_BEGIN(t) int64_t t = _aoi_now()
+#define AOI_TRACE_END(aoi, t, name, id) _aoi_trace_push(aoi, t, name, id)
+#else
+#define AOI_TRACE_BEGIN(t)
+#define AOI_TRACE_END(aoi, t, name, id)
+#endif // AOI_TRACE
+
+#if defined(AOI_TRACE) && AOI_TRACE >= 2
+#define AOI_TRACE_BEGIN2(t) AOI_TRACE_BEGIN(t)
+#define AOI_TRACE_END2(aoi, t, name, id) AOI_TRACE_END(aoi, t, name, id)
+#else
+#define AOI_TRACE_BEGIN2(t)
+#define AOI_TRACE_END2(aoi, t, name, id)
+#endif
+
 
 AOI_API int
 aoi_memsize(void) {
     return sizeof(struct aoi);
 }
 
+/**
+ * sin^2 over half period, extra entry for interpolation at end,
+ * sinf(M_PI * i / AOI_WOBBLE_LUT) squared for AOI_WOBBLE_LUT 256.
+ */
+static const float _aoi_wobble[AOI_WOBBLE_LUT + 2] = {
+    0.0f, 0.000150590655f, 0.000602271932f, 0.00135477178f,
+    0.00240763673f, 0.00376023329f, 0.00541174551f, 0.00736117968f,
+    0.00960735977f, 0.0121489344f, 0.0149843739f, 0.0181119684f,
+    0.021529831f, 0.0252359118f, 0.029227972f, 0.0335035995f,
+    0.038060233f, 0.0428951271f, 0.0480053499f, 0.0533878542f,
+    0.0590393767f, 0.064956516f, 0.0711357072f, 0.0775732175f,
+    0.0842652023f, 0.0912075937f, 0.0983962417f, 0.105826803f,
+    0.113494776f, 0.12139558f, 0.129524454f, 0.137876466f,
+    0.14644663f, 0.155229747f, 0.164220542f, 0.17341359f,
+    0.182803348f, 0.192384213f, 0.20215036f, 0.212095901f,
+    0.222214893f, 0.232501179f, 0.242948666f, 0.253550887f,
+    0.264301658f, 0.275194377f, 0.286222428f, 0.297379345f,
+    0.308658302f, 0.320052505f, 0.331555128f, 0.343159199f,
+    0.354857683f, 0.366643578f, 0.378509969f, 0.390449405f,
+    0.402454913f, 0.414519072f, 0.426634759f, 0.438794702f,
+    0.450991452f, 0.463217735f, 0.475466192f, 0.48772946f,
+    0.49999997f, 0.512270629f, 0.524533868f, 0.536782265f,
+    0.549008667f, 0.561205328f, 0.573365271f, 0.585480988f,
+    0.597545147f, 0.609550714f, 0.621490061f, 0.633356392f,
+    0.645142317f, 0.656840801f, 0.668444932f, 0.679947555f,
+    0.691341758f, 0.702620685f, 0.713777542f, 0.724805653f,
+    0.735698462f, 0.746449053f, 0.757051349f, 0.76749891f,
+    0.777785182f, 0.787904143f, 0.797849655f, 0.807615817f,
+    0.817196667f, 0.826586485f, 0.835779548f, 0.844770312f,
+    0.853553355f, 0.862123549f, 0.87047559f, 0.878604412f,
+    0.886505187f, 0.894173265f, 0.901603818f, 0.908792377f,
+    0.915734828f, 0.922426879f, 0.9288643f, 0.935043454f,
+    0.940960646f, 0.946612179f, 0.951994598f, 0.957104921f,
+    0.961939812f, 0.966496408f, 0.970772028f, 0.974764049f,
+    0.978470147f, 0.981888115f, 0.98501569f, 0.987851083f,
+    0.990392625f, 0.992638826f, 0.994588196f, 0.996239722f,
+    0.99759233f, 0.998645306f, 0.999397755f, 0.999849439f,
+    1.0f, 0.999849439f, 0.999397755f, 0.998645186f,
+    0.99759233f, 0.996239722f, 0.994588196f, 0.992638826f,
+    0.990392625f, 0.987851083f, 0.985015571f, 0.981887996f,
+    0.978470147f, 0.974764049f, 0.970772028f, 0.966496408f,
+    0.961939692f, 0.957104921f, 0.951994598f, 0.94661206f,
+    0.940960646f, 0.935043454f, 0.9288643f, 0.92242676f,
+    0.915734708f, 0.908792377f, 0.901603699f, 0.894173145f,
+    0.886505187f, 0.878604293f, 0.87047559f, 0.862123549f,
+    0.853553355f, 0.844770312f, 0.835779428f, 0.826586485f,
+    0.817196667f, 0.807615757f, 0.797849655f, 0.787904024f,
+    0.777785063f, 0.767498672f, 0.757051408f, 0.746449053f,
+    0.735698342f, 0.724805593f, 0.713777483f, 0.702620566f,
+    0.691341579f, 0.679947555f, 0.668444932f, 0.656840801f,
+    0.645142317f, 0.633356333f, 0.621489942f, 0.609550416f,
+    0.597545207f, 0.585480928f, 0.573365211f, 0.561205268f,
+    0.549008489f, 0.536782086f, 0.524533689f, 0.512270629f,
+    0.49999997f, 0.487729371f, 0.475466102f, 0.463217646f,
+    0.450991303f, 0.438794464f, 0.426634759f, 0.414519072f,
+    0.402454823f, 0.390449345f, 0.37850982f, 0.366643518f,
+    0.354857445f, 0.343159109f, 0.331555039f, 0.320052415f,
+    0.308658242f, 0.297379196f, 0.286222279f, 0.275194198f,
+    0.264301658f, 0.253550887f, 0.242948577f, 0.232501119f,
+    0.222214773f, 0.212095767f, 0.202150375f, 0.192384213f,
+    0.182803318f, 0.173413515f, 0.164220452f, 0.155229628f,
+    0.146446496f, 0.137876496f, 0.129524454f, 0.121395558f,
+    0.113494739f, 0.105826728f, 0.0983961448f, 0.0912075043f,
+    0.0842652172f, 0.0775732175f, 0.0711356774f, 0.0649564639f,
+    0.0590393171f, 0.0533877872f, 0.0480052792f, 0.0428951345f,
+    0.0380602293f, 0.0335035846f, 0.0292279404f, 0.0252358746f,
+    0.02152979f, 0.0181119163f, 0.0149843795f, 0.0121489326f,
+    0.00960735139f, 0.00736116432f, 0.00541172782f, 0.00376021396f,
+    0.0024076181f, 0.00135477283f, 0.000602271f, 0.000150589345f,
+    7.64274186e-15f, 0.000150593653f
+};
+
 AOI_API void
 aoi_init(struct aoi *aoi) {
+    int i;
     memset(aoi, 0, sizeof *aoi);
     aoi->id = 0;
+    for (i = 0; i < AOI_MAX_ROOM; i++) {
+        aoi->room[i] = ~(uint64_t)0;
+    }
+    aoi->g_cur = -1;
+    aoi->g_rebuild = -1;
 }
 
 AOI_API void
 aoi_unit(struct aoi *aoi) {
+    int i;
+    while (aoi->n_alive > 0) {
+        aoi_leave(aoi, aoi->alive[aoi->n_alive - 1]->id);
+    }
+    for (i = 0; i < AOI_MAX_AOI / AOI_EXT_CHUNK; i++) {
+        free(aoi->ext[i]);
+        aoi->ext[i] = 0;
+    }
+    free(aoi->log_list);
+    aoi->log_list = 0;
+    free(aoi->large);
+    aoi->large = 0;
+    free(aoi->arrive);
+    aoi->arrive = 0;
+    free(aoi->vel);
+    free(aoi->vel_v);
+    free(aoi->vel_p);
+    aoi->vel = 0;
+    aoi->vel_v = 0;
+    aoi->vel_p = 0;
+}
+
+/**
+ * Get other state of object.
+ */
+static inline struct aoi_ext *
+_aoi_ext(struct aoi *aoi, struct aoi_object *obj) {
+    int i = (int)(obj - aoi->slot);
+    return &aoi->ext[i >> AOI_EXT_CHUNK_P][i & (AOI_EXT_CHUNK - 1)];
+}
 
+/**
+ * Append change of object to change log, move once if not read yet.
+ */
+static inline void
+_aoi_log(struct aoi *aoi, struct aoi_object *obj, int e) {
+    struct aoi_ext *x;
+    struct aoi_change *c;
+    if (aoi->n_spectator == 0 && aoi->log_readers == 0) {
+        return;
+    }
+    x = _aoi_ext(aoi, obj);
+    if (e == AOI_CHANGE_MOVE && x->log_at
+            && (int)(x->log_at - 1 - aoi->log_read) >= 0) {
+        return;
+    }
+    x->log_at = aoi->log_head + 1;
+    c = &aoi->log[aoi->log_head++ % AOI_LOG_SIZE];
+    c->id = obj->id;
+    c->e = e;
 }
 
 /**
@@ -253,6 +861,13 @@ _aoi_next_id(struct aoi *aoi) {
         }
         obj = &aoi->slot[AOI_HASH_ID(id)];
         if (obj->type == AOI_OBJECT_INVALID) {
+            struct aoi_ext **c = &aoi->ext[AOI_HASH_ID(id) >> AOI_EXT_CHUNK_P];
+            if (!*c) {
+                *c = (struct aoi_ext *)calloc(AOI_EXT_CHUNK, sizeof **c);
+                if (!*c) {
+                    return -1;
+                }
+            }
             memset(obj, 0, sizeof *obj);
             obj->type = AOI_OBJECT_RESERVE;
             obj->id = id;
@@ -275,10 +890,134 @@ _aoi_object(struct aoi *aoi, int id) {
     return obj;
 }
 
+static inline int
+_aoi_grid_div(int v, int cell) {
+    return v >= 0 ? v / cell : -((cell - 1 - v) / cell);
+}
+
+static inline unsigned int
+_aoi_grid_hash(int cx, int cy) {
+    return ((unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u)
+           & (AOI_GRID_BUCKET - 1);
+}
+
+static void
+_aoi_grid_insert(struct aoi *aoi, int g, struct aoi_object *obj) {
+    struct aoi_grid *grid = &aoi->grid[g];
+    struct aoi_ext *x = _aoi_ext(aoi, obj);
+    struct aoi_object **head;
+    x->g_in = g;
+    x->g_cell[0] = _aoi_grid_div(obj->p[0], grid->cell);
+    x->g_cell[1] = _aoi_grid_div(obj->p[1], grid->cell);
+    head = &grid->bucket[_aoi_grid_hash(x->g_cell[0], x->g_cell[1])];
+    x->g_prev = 0;
+    x->g_next = *head;
+    if (*head) {
+        _aoi_ext(aoi, *head)->g_prev = obj;
+    }
+    *head = obj;
+    grid->n++;
+}
+
+static void
+_aoi_grid_erase(struct aoi *aoi, struct aoi_object *obj) {
+    struct aoi_ext *x = _aoi_ext(aoi, obj);
+    struct aoi_grid *grid;
+    if (x->g_in < 0) {
+        return;
+    }
+    grid = &aoi->grid[x->g_in];
+    if (x->g_prev) {
+        _aoi_ext(aoi, x->g_prev)->g_next = x->g_next;
+    } else {
+        grid->bucket[_aoi_grid_hash(x->g_cell[0], x->g_cell[1])] = x->g_next;
+    }
+    if (x->g_next) {
+        _aoi_ext(aoi, x->g_next)->g_prev = x->g_prev;
+    }
+    x->g_prev = 0;
+    x->g_next = 0;
+    x->g_in = -1;
+    grid->n--;
+}
+
+/**
+ * Move object to its cell after position changed, in rebuilding
+ * move it to the new grid.
+ */
+static void
+_aoi_grid_move(struct aoi *aoi, struct aoi_object *obj) {
+    struct aoi_ext *x = _aoi_ext(aoi, obj);
+    int g = aoi->g_rebuild >= 0 ? !aoi->g_cur : aoi->g_cur;
+    if (x->g_in == g) {
+        int cell = aoi->grid[g].cell;
+        if (_aoi_grid_div(obj->p[0], cell) == x->g_cell[0]
+                && _aoi_grid_div(obj->p[1], cell) == x->g_cell[1]) {
+            return;
+        }
+    }
+    _aoi_grid_erase(aoi, obj);
+    _aoi_grid_insert(aoi, g, obj);
+}
+
+/**
+ * Rebuild a step of grid, objects moved to new grid in AOI_GRID_STEP ticks,
+ * then the new grid in use.
+ */
+static void
+_aoi_grid_step(struct aoi *aoi) {
+    int g = !aoi->g_cur;
+    int n = aoi->n_alive / AOI_GRID_STEP + 1;
+    while (n-- > 0 && aoi->g_rebuild < aoi->n_alive) {
+        struct aoi_object *obj = aoi->alive[aoi->g_rebuild++];
+        struct aoi_ext *x = _aoi_ext(aoi, obj);
+        if (x->g_in != g && !x->parent) {
+            _aoi_grid_erase(aoi, obj);
+            _aoi_grid_insert(aoi, g, obj);
+        }
+    }
+    if (aoi->g_rebuild >= aoi->n_alive) {
+        aoi->g_cur = g;
+        aoi->g_rebuild = -1;
+    }
+}
+
+/**
+ * Tune cell size by statistics of grid query, rebuild grid if changed.
+ * Many objects tested per hit shrink cell, many cells per query grow cell,
+ * both by square root of the ratio, mostly empty cells grow cell.
+ */
+static void
+_aoi_grid_tune(struct aoi *aoi) {
+    int64_t *st = aoi->g_stat;
+    int64_t hit = st[3] > st[0] ? st[3] : st[0];
+    int cell = aoi->grid[aoi->g_cur].cell;
+    int c = cell;
+    if (st[0] < AOI_GRID_TUNE) {
+        return;
+    }
+    if (st[2] > 4 * hit && st[1] < 36 * st[0]) {
+        float f = sqrtf(4.0f * hit / st[2]);
+        c = (int)(cell * (f > 0.25f ? f : 0.25f));
+    } else if (st[1] > 64 * st[0]) {
+        float f = sqrtf((float)st[1] / (16 * st[0]));
+        c = (int)(cell * (f < 4.0f ? f : 4.0f));
+    } else if (st[1] > 4 * (st[2] + st[0])) {
+        c = cell * 3 / 2;
+    }
+    memset(st, 0, sizeof aoi->g_stat);
+    if (c < AOI_FIX(1) || c == cell) {
+        return;
+    }
+    aoi->grid[!aoi->g_cur].cell = c;
+    aoi->g_rebuild = 0;
+}
+
 AOI_API int
 aoi_enter(struct aoi *aoi, void *ud) {
     int id, i;
     struct aoi_object *obj;
+    struct aoi_ext *x;
 
     id = _aoi_next_id(aoi);
     if (-1 == id) {
@@ -301,7 +1040,17 @@ aoi_enter(struct aoi *aoi, void *ud) {
     obj->o_list = (int *)malloc((AOI_DEF_AOI + 2)*sizeof(int));
     obj->o_list[0] = 0;
     obj->o_list[1] = AOI_DEF_AOI;
-    obj->ud = ud;
+    x = _aoi_ext(aoi, obj);
+    x->ud = ud;
+    x->idx = aoi->n_alive;
+    aoi->alive[aoi->n_alive++] = obj;
+    x->g_in = -1;
+    if (aoi->g_cur >= 0) {
+        _aoi_grid_insert(aoi, aoi->g_rebuild >= 0 ? !aoi->g_cur : aoi->g_cur,
+                         obj);
+    }
+    aoi->gen++;
+    _aoi_log(aoi, obj, AOI_CHANGE_ENTER);
     return id;
 }
 
@@ -349,9 +1098,24 @@ _aoi_list_insert_before(struct aoi *aoi, int list, struct aoi_object *obj,
     p->prev[list] = obj;
 }
 
+/**
+ * Set position of attached objects by parent.
+ */
+static inline void
+_aoi_attach_follow(struct aoi *aoi, struct aoi_object *obj) {
+    struct aoi_object *c;
+    for (c = obj->child; c; c = c->sibling) {
+        struct aoi_ext *x = _aoi_ext(aoi, c);
+        c->p[0] = obj->p[0] + x->off[0];
+        c->p[1] = obj->p[1] + x->off[1];
+        _aoi_log(aoi, c, AOI_CHANGE_MOVE);
+    }
+}
+
 static void
 _aoi_update_list(struct aoi *aoi, struct aoi_object *obj, int d[2]) {
     int i;
+    AOI_TRACE_BEGIN2(ts);
     for (i = 0; i < 2; i++) {
         if (d[i] > 0) {
             struct aoi_object *p = obj;
@@ -379,11 +1143,101 @@ _aoi_update_list(struct aoi *aoi, struct aoi_object *obj, int d[2]) {
             }
         }
     }
+    if (obj->child) {
+        _aoi_attach_follow(aoi, obj);
+    }
+    aoi->gen++;
+    _aoi_log(aoi, obj, AOI_CHANGE_MOVE);
+    if (aoi->g_cur >= 0) {
+        _aoi_grid_move(aoi, obj);
+    }
+    AOI_TRACE_END2(aoi, ts, "relink", obj->id);
+}
+
+/**
+ * Detach object from parent, put it back to x and y axis list.
+ */
+static void
+_aoi_detach(struct aoi *aoi, struct aoi_object *obj) {
+    struct aoi_ext *x = _aoi_ext(aoi, obj);
+    struct aoi_object *parent = x->parent, **pp;
+    int i;
+    if (!parent) {
+        return;
+    }
+    for (pp = &parent->child; *pp != obj; pp = &(*pp)->sibling)
+        ;
+    *pp = obj->sibling;
+    x->parent = 0;
+    obj->sibling = 0;
+    if (--aoi->n_attach == 0) {
+        aoi->attach_r = 0;
+    }
+    for (i = 0; i < 2; i++) {
+        _aoi_list_insert_after(aoi, i, obj, parent);
+    }
+    _aoi_update_list(aoi, obj, x->off);
+}
+
+/**
+ * Remove object from its group, leader leave dissolve the group.
+ */
+static void
+_aoi_group_leave(struct aoi *aoi, struct aoi_object *obj) {
+    struct aoi_ext *x = _aoi_ext(aoi, obj);
+    struct aoi_object *leader = x->leader, *m;
+    if (!leader) {
+        return;
+    }
+    if (leader == obj) {
+        while (obj) {
+            x = _aoi_ext(aoi, obj);
+            obj = x->member;
+            x->leader = 0;
+            x->member = 0;
+        }
+        x = _aoi_ext(aoi, leader);
+        free(x->c_list);
+        x->c_list = 0;
+        return;
+    }
+    for (m = leader; _aoi_ext(aoi, m)->member != obj;
+            m = _aoi_ext(aoi, m)->member)
+        ;
+    _aoi_ext(aoi, m)->member = x->member;
+    x->leader = 0;
+    x->member = 0;
+}
+
+static void
+_aoi_velocity_erase(struct aoi *aoi, struct aoi_object *obj) {
+    struct aoi_ext *x = _aoi_ext(aoi, obj);
+    int i = x->vel_idx - 1, last;
+    if (i < 0) {
+        return;
+    }
+    last = --aoi->n_vel;
+    aoi->vel[i] = aoi->vel[last];
+    _aoi_ext(aoi, aoi->vel[i])->vel_idx = i + 1;
+    memcpy(aoi->vel_v[i], aoi->vel_v[last], sizeof aoi->vel_v[i]);
+    memcpy(aoi->vel_p[i], aoi->vel_p[last], sizeof aoi->vel_p[i]);
+    x->vel_idx = 0;
+}
+
+static void
+_aoi_large_erase(struct aoi *aoi, struct aoi_object *obj) {
+    struct aoi_ext *x = _aoi_ext(aoi, obj);
+    if (x->vis > 0) {
+        aoi->large[x->v_idx] = aoi->large[--aoi->n_large];
+        _aoi_ext(aoi, aoi->large[x->v_idx])->v_idx = x->v_idx;
+        x->vis = 0;
+    }
 }
 
 AOI_API void
 aoi_leave(struct aoi *aoi, int id) {
-    struct aoi_object *obj;
+    struct aoi_object *obj, *last;
+    struct aoi_ext *x;
     int i;
 
     obj = _aoi_object(aoi, id);
@@ -391,13 +1245,35 @@ aoi_leave(struct aoi *aoi, int id) {
         return;
     }
 
+    _aoi_detach(aoi, obj);
+    while (obj->child) {
+        _aoi_detach(aoi, obj->child);
+    }
     /** remove object from x and y axis */
     for (i = 0; i < 2; i++) {
         _aoi_list_erase(aoi, i, obj);
     }
+    x = _aoi_ext(aoi, obj);
     free(obj->n_list);
     free(obj->o_list);
+    free(x->h_list[0]);
+    free(x->h_list[1]);
+    _aoi_grid_erase(aoi, obj);
+    _aoi_group_leave(aoi, obj);
+    _aoi_large_erase(aoi, obj);
+    _aoi_velocity_erase(aoi, obj);
+    _aoi_log(aoi, obj, AOI_CHANGE_LEAVE);
+    aoi->n_spectator -= x->spectator;
+    /** remove object from alive list */
+    last = aoi->alive[--aoi->n_alive];
+    aoi->alive[x->idx] = last;
+    _aoi_ext(aoi, last)->idx = x->idx;
+    if (aoi->g_rebuild > x->idx && _aoi_ext(aoi, last)->g_in >= 0) {
+        /** object swapped before rebuild cursor, move it to new grid */
+        _aoi_grid_move(aoi, last);
+    }
     memset(obj, 0, sizeof *obj);
+    memset(x, 0, sizeof *x);
     obj->type = AOI_OBJECT_INVALID;
 }
 
@@ -405,41 +1281,78 @@ AOI_API void *
 aoi_ud(struct aoi *aoi, int id) {
     struct aoi_object *obj = _aoi_object(aoi, id);
     if (obj) {
-        return obj->ud;
+        return _aoi_ext(aoi, obj)->ud;
     }
     return 0;
 }
 
-AOI_API void
-aoi_locate(struct aoi *aoi, int id, int x, int y) {
-    struct aoi_object *obj;
+static void
+_aoi_attach_offset(struct aoi *aoi, struct aoi_object *obj, int x, int y) {
+    struct aoi_ext *e = _aoi_ext(aoi, obj);
+    int r = abs(x) > abs(y) ? abs(x) : abs(y);
+    e->off[0] = x;
+    e->off[1] = y;
+    obj->p[0] = e->parent->p[0] + x;
+    obj->p[1] = e->parent->p[1] + y;
+    if (r > aoi->attach_r) {
+        aoi->attach_r = r;
+    }
+    aoi->gen++;
+    _aoi_log(aoi, obj, AOI_CHANGE_MOVE);
+}
+
+static void
+_aoi_locate(struct aoi *aoi, struct aoi_object *obj, int x, int y) {
+    struct aoi_ext *e = _aoi_ext(aoi, obj);
     int d[2];
 
-    obj = _aoi_object(aoi, id);
-    if (!obj) {
+    if (e->parent) {
+        /** attached object change offset only */
+        _aoi_attach_offset(aoi, obj, x - e->parent->p[0],
+                           y - e->parent->p[1]);
         return;
     }
+
     d[0] = (x - obj->p[0]);
     d[1] = (y - obj->p[1]);
     obj->p[0] = x;
     obj->p[1] = y;
+    if (e->vel_idx) {
+        aoi->vel_p[e->vel_idx - 1][0] = (float)x;
+        aoi->vel_p[e->vel_idx - 1][1] = (float)y;
+    }
     /** update object position in x and y axis */
     _aoi_update_list(aoi, obj, d);
 }
 
 AOI_API void
-aoi_move(struct aoi *aoi, int id, int x, int y) {
-    struct aoi_object *obj;
-    int i, d[2];
-    float c;
+aoi_locate(struct aoi *aoi, int id, int x, int y) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return;
+    }
+    _aoi_locate(aoi, obj, AOI_FIX(x), AOI_FIX(y));
+}
 
-    obj = _aoi_object(aoi, id);
+AOI_API void
+aoi_locatef(struct aoi *aoi, int id, float x, float y) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
     if (!obj) {
         return;
     }
-    if (obj->speed <= 0 || (x == obj->p[0] && y == obj->p[1])) {
+    _aoi_locate(aoi, obj, AOI_FIXF(x), AOI_FIXF(y));
+}
+
+static void
+_aoi_move(struct aoi *aoi, struct aoi_object *obj, int x, int y) {
+    int i, d[2];
+    float c;
+
+    if (obj->speed <= 0 || _aoi_ext(aoi, obj)->parent
+            || (x == obj->p[0] && y == obj->p[1])) {
         return;
     }
+    _aoi_velocity_erase(aoi, obj);
     d[0] = x;
     d[1] = y;
     for (i = 0; i < 2; i++) {
@@ -447,26 +1360,65 @@ aoi_move(struct aoi *aoi, int id, int x, int y) {
         obj->dp[i] = d[i];
         d[i] -= obj->p[i];
     }
-    c = sqrtf((float)(d[0] * d[0] + d[1] * d[1]));
+    c = sqrtf((float)d[0] * d[0] + (float)d[1] * d[1]);
     for (i = 0; i < 2; i++) {
         obj->d[i] = d[i] / c;
     }
-    obj->e = (float)M_PI*obj->speed / c;
+    obj->motion = _aoi_ext(aoi, obj)->motion;
+    obj->e = (float)AOI_WOBBLE_LUT*obj->speed / c;
     obj->n_tick = (int)c / obj->speed;
     obj->p_tick = 0;
 }
 
 AOI_API void
-aoi_speed(struct aoi *aoi, int id, int speed) {
+aoi_move(struct aoi *aoi, int id, int x, int y) {
     struct aoi_object *obj = _aoi_object(aoi, id);
     if (!obj) {
         return;
     }
+    _aoi_move(aoi, obj, AOI_FIX(x), AOI_FIX(y));
+}
+
+AOI_API void
+aoi_movef(struct aoi *aoi, int id, float x, float y) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return;
+    }
+    _aoi_move(aoi, obj, AOI_FIXF(x), AOI_FIXF(y));
+}
+
+static void
+_aoi_speed(struct aoi *aoi, struct aoi_object *obj, int speed) {
     obj->speed = speed;
     if (obj->n_tick > 0) {
         /** object in moving, take effect change of speed */
-        aoi_move(aoi, obj->id, obj->dp[0], obj->dp[1]);
+        _aoi_move(aoi, obj, obj->dp[0], obj->dp[1]);
+    }
+}
+
+AOI_API void
+aoi_speed(struct aoi *aoi, int id, int speed) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return;
+    }
+    _aoi_speed(aoi, obj, AOI_FIX(speed));
+}
+
+AOI_API void
+aoi_speedf(struct aoi *aoi, int id, float speed) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return;
     }
+    _aoi_speed(aoi, obj, AOI_FIXF(speed));
+}
+
+static inline float
+_aoi_wobble_at(float f) {
+    int i = (int)f;
+    return _aoi_wobble[i] + (_aoi_wobble[i + 1] - _aoi_wobble[i]) * (f - i);
 }
 
 static void
@@ -474,6 +1426,7 @@ _aoi_object_update(struct aoi *aoi, struct aoi_object *obj, int tick) {
     int i, ti;
     int d[2];
 
+    AOI_TRACE_BEGIN(ts);
     ti = min(tick, obj->n_tick);
     obj->n_tick -= ti;
     obj->p_tick += ti;
@@ -485,15 +1438,58 @@ _aoi_object_update(struct aoi *aoi, struct aoi_object *obj, int tick) {
         for (i = 0; i < 2; i++) {
             obj->p[i] = obj->dp[i];
         }
+    } else if (obj->motion == AOI_MOTION_LINEAR) {
+        for (i = 0; i < 2; i++) {
+            obj->p[i] = (int)(obj->sp[i]
+                              + obj->d[i] * obj->speed*obj->p_tick);
+        }
+    } else if (obj->motion == AOI_MOTION_EASE) {
+        /** smoothstep of progress over the whole way */
+        float u = (float)obj->p_tick / (obj->p_tick + obj->n_tick);
+        float s = u * u * (3 - 2 * u);
+        for (i = 0; i < 2; i++) {
+            obj->p[i] = (int)(obj->sp[i] + (obj->dp[i] - obj->sp[i]) * s);
+        }
     } else {
         /** make moving step */
-        float s = sinf(obj->e*obj->p_tick)*sinf(obj->e*obj->p_tick);
+        float s = _aoi_wobble_at(obj->e*obj->p_tick);
         for (i = 0; i < 2; i++) {
             obj->p[i] = (int)(obj->sp[i] + obj->d[i] * obj->speed*obj->p_tick
-                              + ((i << 1) - 1) * obj->d[i] * s);
+                              + ((i << 1) - 1) * obj->d[i] * s * AOI_FIX(1));
         }
     }
     _aoi_update_list(aoi, obj, d);
+    AOI_TRACE_END(aoi, ts, "update", obj->id);
+}
+
+/**
+ * Integrate position of objects moving by velocity, then relink them.
+ */
+static void
+_aoi_velocity_update(struct aoi *aoi, int tick) {
+    float *p = &aoi->vel_p[0][0];
+    const float *v = &aoi->vel_v[0][0];
+    int i, j, n = aoi->n_vel * 2;
+    for (i = 0; i < n; i++) {
+        p[i] += v[i] * tick;
+    }
+    for (i = 0; i < aoi->n_vel; i++) {
+        struct aoi_object *obj = aoi->vel[i];
+        int d[2], moved = 0;
+        if (_aoi_ext(aoi, obj)->parent) {
+            /** attached object follow parent */
+            continue;
+        }
+        for (j = 0; j < 2; j++) {
+            int x = (int)aoi->vel_p[i][j];
+            d[j] = ((aoi->vel_v[i][j] > 0) << 1) - 1;
+            moved |= x != obj->p[j];
+            obj->p[j] = x;
+        }
+        if (moved) {
+            _aoi_update_list(aoi, obj, d);
+        }
+    }
 }
 
 AOI_API void
@@ -517,8 +1513,18 @@ aoi_pos(struct aoi *aoi, int id, int *px, int *py) {
     if (!obj) {
         return;
     }
-    *px = obj->p[0];
-    *py = obj->p[1];
+    *px = AOI_UNFIX(obj->p[0]);
+    *py = AOI_UNFIX(obj->p[1]);
+}
+
+AOI_API void
+aoi_posf(struct aoi *aoi, int id, float *px, float *py) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return;
+    }
+    *px = AOI_UNFIXF(obj->p[0]);
+    *py = AOI_UNFIXF(obj->p[1]);
 }
 
 AOI_API int
@@ -560,6 +1566,133 @@ _insert_list(int *list, int id) {
     return list;
 }
 
+static int *
+_append_list(int *list, int id) {
+    int cur = list[0];
+    if (cur >= list[1]) {
+        list = (int *)realloc(list, (list[1] * 2 + 2) * sizeof(int));
+        list[1] *= 2;
+    }
+    list[cur + 2] = id;
+    list[0]++;
+    return list;
+}
+
+static int *
+_append_hold(int *list, int id, int tick) {
+    int cur = list[0];
+    if (cur >= list[1]) {
+        list = (int *)realloc(list, (list[1] * 4 + 2) * sizeof(int));
+        list[1] *= 2;
+    }
+    list[cur * 2 + 2] = id;
+    list[cur * 2 + 3] = tick;
+    list[0]++;
+    return list;
+}
+
+/**
+ * Keep object out of sight in new list until it stay out for dwell ticks,
+ * hold list record the tick when it out of sight.
+ */
+static int *
+_aoi_dwell_hold(struct aoi *aoi, struct aoi_object *obj, int *cur_list) {
+    struct aoi_ext *x = _aoi_ext(aoi, obj);
+    int *o_list = obj->o_list;
+    int *h_list = x->h_list[0];
+    int *k_list = x->h_list[1];
+    int n_cnt = cur_list[0];
+    int h_cnt = h_list[0];
+    int o_i, n_i = 2, h_i = 0, i;
+
+    k_list[0] = 0;
+    for (o_i = 2; o_i <= o_list[0] + 1; o_i++) {
+        int o = o_list[o_i];
+        int tick = x->t_tick;
+        while (n_i <= n_cnt + 1 && cur_list[n_i] < o) {
+            n_i++;
+        }
+        if (n_i <= n_cnt + 1 && cur_list[n_i] == o) {
+            continue;
+        }
+        if (!_aoi_object(aoi, o)) {
+            continue;
+        }
+        while (h_i < h_cnt && h_list[h_i * 2 + 2] < o) {
+            h_i++;
+        }
+        if (h_i < h_cnt && h_list[h_i * 2 + 2] == o) {
+            tick = h_list[h_i * 2 + 3];
+        }
+        if (x->t_tick - tick < x->dwell) {
+            k_list = _append_hold(k_list, o, tick);
+        }
+    }
+    for (i = 0; i < k_list[0]; i++) {
+        cur_list = _insert_list(cur_list, k_list[i * 2 + 2]);
+    }
+    x->h_list[0] = k_list;
+    x->h_list[1] = h_list;
+    return cur_list;
+}
+
+/**
+ * Whether offset dx, dy in view shape with half width r.
+ * cone test dot product with facing against cosine of half angle,
+ * compare in square to avoid sqrtf.
+ */
+static inline int
+_aoi_shape_in(const struct aoi_shape *shape, int dx, int dy, int r) {
+    int64_t x = dx, y = dy;
+    switch (shape->type) {
+    case AOI_SHAPE_RECT:
+        return llabs(x) <= r && llabs(y) * shape->w <= (int64_t)r * shape->h;
+    case AOI_SHAPE_ELLIPSE:
+        return x * x * shape->h * shape->h + y * y * shape->w * shape->w
+               <= (int64_t)r * r * shape->h * shape->h;
+    case AOI_SHAPE_CONE: {
+        float dot, l;
+        if (x * x + y * y > (int64_t)r * r) {
+            return 0;
+        }
+        dot = shape->f[0] * dx + shape->f[1] * dy;
+        l = shape->c * shape->c * ((float)dx * dx + (float)dy * dy);
+        if (shape->c >= 0) {
+            return dot >= 0 && dot * dot >= l;
+        }
+        return dot >= 0 || dot * dot <= l;
+    }
+    default:
+        return x * x + y * y <= (int64_t)r * r;
+    }
+}
+
+/**
+ * Maximum half extent of view shape with half width r.
+ */
+static inline int
+_aoi_shape_extent(const struct aoi_shape *shape, int r) {
+    if (shape->type == AOI_SHAPE_RECT || shape->type == AOI_SHAPE_ELLIPSE) {
+        int h = (int)(((int64_t)r * shape->h + shape->w - 1) / shape->w);
+        return h > r ? h : r;
+    }
+    return r;
+}
+
+static void
+_aoi_shape_cone(struct aoi_shape *shape, float fx, float fy, float angle) {
+    float l = sqrtf(fx * fx + fy * fy);
+    shape->type = AOI_SHAPE_CONE;
+    if (l > 0) {
+        shape->f[0] = fx / l;
+        shape->f[1] = fy / l;
+    } else {
+        shape->f[0] = 1;
+        shape->f[1] = 0;
+    }
+    shape->c = cosf(angle);
+}
+
 static int
 _find_list(int *list, int id) {
     int cur = list[0];
@@ -577,40 +1710,85 @@ _find_list(int *list, int id) {
     return 0;
 }
 
-AOI_API int
-aoi_trigger(struct aoi *aoi, int id, int enter_r, int leave_r,
-            struct aoi_event **list) {
-    struct aoi_object *obj, *p;
-    int *cur_list, i;
-    int r = 0;
+/**
+ * State of scan for new version object list around.
+ */
+struct aoi_scan {
+    struct aoi_object *obj;
+    struct aoi_ext *x;          /* other state of obj */
+    struct aoi_shape shape;     /* copy of view shape, kept out of aliasing */
+    struct aoi_object *anchor;  /* object in index, parent if attached */
+    uint64_t room;      /* rooms visible */
+    int enter_r;
+    int leave_r;
+    int reach;          /* leave radius add maximum offset of attached */
+    int attach;         /* any attached object */
+    int *list;          /* new version object list */
+    int work;           /* objects tested */
+    int cells;          /* cells visited and grid entries walked in them */
+};
 
-    obj = _aoi_object(aoi, id);
-    if (!obj) {
-        return r;
+/**
+ * Test other object and insert it into new version list if in sight.
+ */
+static inline void
+_aoi_scan_one(struct aoi_scan *s, struct aoi_object *p) {
+    struct aoi_object *obj = s->obj;
+    int dx = p->p[0] - obj->p[0];
+    int dy = p->p[1] - obj->p[1];
+    s->work++;
+    if (!(s->room & ((uint64_t)1 << p->room))) {
+        /** other object in room not visible */
+    } else if (_aoi_shape_in(&s->shape, dx, dy, s->enter_r)) {
+        s->list = _insert_list(s->list, p->id);
+    } else if (_aoi_shape_in(&s->shape, dx, dy, s->leave_r)) {
+        if (_find_list(obj->o_list, p->id)) {
+            s->list = _insert_list(s->list, p->id);
+        }
+    }
+}
+
+/**
+ * Test object in index and objects attached to it, except self.
+ */
+static inline void
+_aoi_scan_test(struct aoi_scan *s, struct aoi_object *p) {
+    struct aoi_object *c;
+    if (p != s->obj) {
+        _aoi_scan_one(s, p);
     }
-    cur_list = obj->n_list;
-    cur_list[0] = 0;
+    if (!s->attach) {
+        return;
+    }
+    for (c = p->child; c; c = c->sibling) {
+        if (c != s->obj) {
+            _aoi_scan_one(s, c);
+        }
+    }
+}
+
+/**
+ * Walk x axis list both side until out of leave radius.
+ */
+static void
+_aoi_scan_sweep(struct aoi_scan *s) {
+    struct aoi_object *obj = s->obj, *p;
+    int i;
+    _aoi_scan_test(s, s->anchor);
     /** only check x axis list is ok */
     for (i = 0; i < 2; i++) {
         if (i == 0) {
-            p = obj->prev[0];
+            p = s->anchor->prev[0];
         } else {
-            p = obj->next[0];
+            p = s->anchor->next[0];
         }
         /** get new version object list in x and y axis */
         while (p) {
-            int dx = abs(obj->p[0] - p->p[0]);
-            int dy = abs(obj->p[1] - p->p[1]);
-            int d = dx * dx + dy * dy;
-            if (dx > leave_r) {
+            if ((i == 0 ? obj->p[0] - p->p[0] : p->p[0] - obj->p[0])
+                    > s->reach) {
                 break;
-            } else if (d <= enter_r * enter_r) {
-                cur_list = _insert_list(cur_list, p->id);
-            } else if (d <= leave_r * leave_r) {
-                if (_find_list(obj->o_list, p->id)) {
-                    cur_list = _insert_list(cur_list, p->id);
-                }
             }
+            _aoi_scan_test(s, p);
             if (i == 0) {
                 p = p->prev[0];
             } else {
@@ -618,87 +1796,1225 @@ aoi_trigger(struct aoi *aoi, int id, int enter_r, int leave_r,
             }
         }
     }
+}
 
-    *list = aoi->elist;
-
-    /** no object in old version list, all in array list is new enter */
-    if (obj->o_list[0] == 0) {
-        int i;
-        for (i = 0; i < cur_list[0]; i++) {
-            (*list)[r].id = cur_list[i + 2];
-            (*list)[r].e = AOI_ENTER;
-            r++;
+/**
+ * Walk x axis list nearest first until work budget used up, objects at
+ * the same distance in x axis are all tested. Then shrink radius to the
+ * distance all objects within are tested, so the result is the nearest.
+ */
+static void
+_aoi_scan_shed(struct aoi *aoi, struct aoi_scan *s) {
+    struct aoi_object *obj = s->obj;
+    struct aoi_object *pl = s->anchor->prev[0];
+    struct aoi_object *pn = s->anchor->next[0];
+    int hit = 0, shrink = 0, near = 0, cut = 0;
+    int last = abs(s->anchor->p[0] - obj->p[0]);
+    _aoi_scan_test(s, s->anchor);
+    for (;;) {
+        int dl, dn, d;
+        if (pl && obj->p[0] - pl->p[0] > s->reach) {
+            pl = 0;
         }
-    } else {
-        /** intersection and subtraction of list */
-        int o_cnt = obj->o_list[0];
-        int n_cnt = cur_list[0];
-        int o_i = 2;
-        int n_i = 2;
-        for (;;) {
-            int o, n;
-            if (o_i > o_cnt + 1) {
-                int i;
-                for (i = n_i; i <= n_cnt + 1; i++) {
-                    (*list)[r].id = cur_list[i];
-                    (*list)[r].e = AOI_ENTER;
-                    r++;
-                }
-                break;
+        if (pn && pn->p[0] - obj->p[0] > s->reach) {
+            pn = 0;
+        }
+        if (!pl && !pn) {
+            break;
+        }
+        dl = pl ? abs(pl->p[0] - obj->p[0]) : INT_MAX;
+        dn = pn ? abs(pn->p[0] - obj->p[0]) : INT_MAX;
+        d = dl < dn ? dl : dn;
+        if (!hit && s->work >= aoi->shed) {
+            hit = 1;
+            near = last;
+        }
+        /** attached object may be nearer than its parent by attach_r */
+        if (hit && d > near + aoi->attach_r) {
+            shrink = 1;
+            cut = d - 1 - aoi->attach_r;
+            break;
+        }
+        if (dl < dn) {
+            _aoi_scan_test(s, pl);
+            pl = pl->prev[0];
+        } else {
+            _aoi_scan_test(s, pn);
+            pn = pn->next[0];
+        }
+        last = d;
+    }
+    if (shrink) {
+        int *list = s->list;
+        int i, j = 2;
+        for (i = 2; i < list[0] + 2; i++) {
+            struct aoi_object *p = _aoi_object(aoi, list[i]);
+            if (p && _aoi_shape_in(&s->shape, p->p[0] - obj->p[0],
+                                   p->p[1] - obj->p[1], cut)) {
+                list[j++] = list[i];
             }
-            if (n_i > n_cnt + 1) {
-                int i;
-                for (i = o_i; i <= o_cnt + 1; i++) {
-                    (*list)[r].id = obj->o_list[i];
-                    (*list)[r].e = AOI_LEAVE;
-                    r++;
+        }
+        list[0] = j - 2;
+    }
+}
+
+/**
+ * Test objects in cells around of grid g, return -1 if too many cells.
+ */
+static int
+_aoi_scan_cell(struct aoi *aoi, struct aoi_scan *s, int g) {
+    struct aoi_object *obj = s->obj;
+    struct aoi_grid *grid = &aoi->grid[g];
+    const struct aoi_shape *shape = &s->shape;
+    int ry = s->leave_r;
+    int c0[2], c1[2], cx, cy;
+    int64_t cells;
+
+    if (shape->type == AOI_SHAPE_RECT || shape->type == AOI_SHAPE_ELLIPSE) {
+        ry = (int)(((int64_t)s->leave_r * shape->h + shape->w - 1)
+                   / shape->w);
+    }
+    ry += s->reach - s->leave_r;
+    c0[0] = _aoi_grid_div(obj->p[0] - s->reach, grid->cell);
+    c1[0] = _aoi_grid_div(obj->p[0] + s->reach, grid->cell);
+    c0[1] = _aoi_grid_div(obj->p[1] - ry, grid->cell);
+    c1[1] = _aoi_grid_div(obj->p[1] + ry, grid->cell);
+    cells = (int64_t)(c1[0] - c0[0] + 1) * (c1[1] - c0[1] + 1);
+    aoi->g_stat[0]++;
+    aoi->g_stat[1] += cells;
+    if (cells > AOI_GRID_BUCKET) {
+        return -1;
+    }
+    s->cells += (int)cells;
+    for (cy = c0[1]; cy <= c1[1]; cy++) {
+        for (cx = c0[0]; cx <= c1[0]; cx++) {
+            struct aoi_object *p = grid->bucket[_aoi_grid_hash(cx, cy)];
+            while (p) {
+                struct aoi_ext *x = _aoi_ext(aoi, p);
+                if (x->g_cell[0] == cx && x->g_cell[1] == cy) {
+                    _aoi_scan_test(s, p);
                 }
-                break;
-            }
-            o = obj->o_list[o_i];
-            if (!_aoi_object(aoi, o)) {
-                o_i++;
-                continue;
-            }
-            n = cur_list[n_i];
-            if (n < o) {
-                (*list)[r].id = n;
-                (*list)[r].e = AOI_ENTER;
-                r++;
-                n_i++;
-            } else if (n == o) {
-                o_i++;
-                n_i++;
-            } else {
-                (*list)[r].id = o;
-                (*list)[r].e = AOI_LEAVE;
-                r++;
-                o_i++;
+                p = x->g_next;
+                s->cells++;
             }
         }
     }
+    return 0;
+}
 
-    /** change list version */
-    obj->n_list = obj->o_list;
-    obj->o_list = cur_list;
-    return r;
+/**
+ * Test objects in grid, in rebuilding objects are in both grid.
+ * return -1 if too many cells, then nothing tested.
+ */
+static int
+_aoi_scan_grid(struct aoi *aoi, struct aoi_scan *s) {
+    if (aoi->g_rebuild >= 0) {
+        int64_t stat[4];
+        memcpy(stat, aoi->g_stat, sizeof stat);
+        if (_aoi_scan_cell(aoi, s, aoi->g_cur) < 0
+                || _aoi_scan_cell(aoi, s, !aoi->g_cur) < 0) {
+            memcpy(aoi->g_stat, stat, sizeof stat);
+            s->list[0] = 0;
+            s->work = 0;
+            s->cells = 0;
+            return -1;
+        }
+        /** statistics of old cell size not used */
+        memcpy(aoi->g_stat, stat, sizeof stat);
+        return 0;
+    }
+    if (_aoi_scan_cell(aoi, s, aoi->g_cur) < 0) {
+        return -1;
+    }
+    aoi->g_stat[2] += s->work;
+    aoi->g_stat[3] += s->list[0];
+    return 0;
 }
 
-AOI_API int
-aoi_around(struct aoi *aoi, int id, int *list, int n) {
-    struct aoi_object *obj;
+/**
+ * Choose x axis list or grid by average cost in tile of the object, cost
+ * of grid include entries of other cells walked in shared buckets.
+ * Try the other one sometimes to follow density change, less often when
+ * it cost much more.
+ */
+static void
+_aoi_scan_hybrid(struct aoi *aoi, struct aoi_scan *s) {
+    struct aoi_object *obj = s->obj;
+    struct aoi_tile *t;
+    int g, flip = 0;
+    t = &aoi->tiles[_aoi_grid_hash(_aoi_grid_div(obj->p[0], aoi->tile),
+                                   _aoi_grid_div(obj->p[1], aoi->tile))
+                    & (AOI_TILE_BUCKET - 1)];
+    g = t->cost[1] < t->cost[0];
+    if (++t->n >= t->wait) {
+        g = !g;
+        flip = 1;
+    }
+    if (!g || _aoi_scan_grid(aoi, s) < 0) {
+        g = 0;
+        _aoi_scan_sweep(s);
+    }
+    /** first cost taken as is, not averaged with nothing */
+    if (t->cost[g] > 0) {
+        t->cost[g] += (s->work + s->cells - t->cost[g]) / 8;
+    } else {
+        t->cost[g] = (float)(s->work + s->cells);
+    }
+    if (flip) {
+        float lo = t->cost[0] < t->cost[1] ? t->cost[0] : t->cost[1];
+        float r = (t->cost[0] + t->cost[1] - lo) / (lo + 1);
+        t->n = 0;
+        t->wait = r < (float)AOI_TILE_WAIT / AOI_TILE_TRY
+                  ? (int)(AOI_TILE_TRY * r) : AOI_TILE_WAIT;
+    }
+}
+
+/**
+ * Get objects around group into candidate list of leader, within leave
+ * radius r of any member.
+ */
+static void
+_aoi_group_build(struct aoi *aoi, struct aoi_object *leader, int r) {
+    struct aoi_ext *x = _aoi_ext(aoi, leader);
+    struct aoi_object *a = x->parent ? x->parent : leader;
+    struct aoi_object *m, *p;
+    int64_t spread = 0;
+    int *list = x->c_list;
     int i;
 
-    obj = _aoi_object(aoi, id);
-    if (!obj) {
-        return 0;
+    for (m = leader; m; m = _aoi_ext(aoi, m)->member) {
+        float dx = (float)(m->p[0] - leader->p[0]);
+        float dy = (float)(m->p[1] - leader->p[1]);
+        int64_t d = (int64_t)sqrtf(dx * dx + dy * dy) + 1
+                    + _aoi_shape_extent(&_aoi_ext(aoi, m)->shape, r);
+        if (d > spread) {
+            spread = d;
+        }
     }
-    n = n > obj->n_list[0] ? obj->n_list[0] : n;
-    for (i = 0; i < n; i++) {
-        list[i] = obj->n_list[i];
+    spread += aoi->attach_r;
+    if (!list) {
+        list = (int *)malloc((AOI_DEF_AOI + 2)*sizeof(int));
+        list[1] = AOI_DEF_AOI;
+    }
+    list[0] = 0;
+    /** objects in index only, attached objects tested through parent */
+    for (i = 0; i < 2; i++) {
+        p = i == 0 ? a : a->next[0];
+        while (p) {
+            int64_t dx = p->p[0] - leader->p[0];
+            int64_t dy = p->p[1] - leader->p[1];
+            if ((i == 0 ? -dx : dx) > spread) {
+                break;
+            }
+            if (dx * dx + dy * dy <= spread * spread) {
+                list = _append_list(list, p->id);
+            }
+            p = i == 0 ? p->prev[0] : p->next[0];
+        }
     }
+    x->c_list = list;
+    x->c_r = r;
+    x->c_gen = aoi->gen;
+}
 
-    return n;
+/**
+ * Test objects around group, shared by members.
+ */
+static void
+_aoi_scan_group(struct aoi *aoi, struct aoi_scan *s) {
+    struct aoi_ext *x = _aoi_ext(aoi, s->x->leader);
+    int i;
+    if (!x->c_list || x->c_gen != aoi->gen || x->c_r < s->leave_r) {
+        _aoi_group_build(aoi, s->x->leader, s->leave_r);
+    }
+    for (i = 0; i < x->c_list[0]; i++) {
+        struct aoi_object *p = _aoi_object(aoi, x->c_list[i + 2]);
+        if (p) {
+            _aoi_scan_test(s, p);
+        }
+    }
+}
+
+static int
+_aoi_id_cmp(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Sorted ids changed since last trigger of spectator into log_list,
+ * return 1 if it must test all objects again.
+ */
+static int
+_aoi_log_collect(struct aoi *aoi, struct aoi_scan *s) {
+    struct aoi_object *obj = s->obj;
+    struct aoi_ext *x = s->x;
+    int *c = aoi->log_list;
+    int key[6], all = 0;
+    unsigned i;
+    key[0] = obj->p[0];
+    key[1] = obj->p[1];
+    key[2] = s->enter_r;
+    key[3] = s->leave_r;
+    key[4] = obj->room;
+    key[5] = aoi->log_epoch;
+    if (!c) {
+        c = (int *)malloc((AOI_DEF_AOI + 2)*sizeof(int));
+        c[1] = AOI_DEF_AOI;
+    }
+    c[0] = 0;
+    if (memcmp(key, x->s_key, sizeof key) != 0
+            || aoi->log_head - x->s_seq > AOI_LOG_SIZE) {
+        for (i = 0; i < (unsigned)aoi->n_alive; i++) {
+            c = _append_list(c, aoi->alive[i]->id);
+        }
+        memcpy(x->s_key, key, sizeof key);
+        all = 1;
+    } else {
+        for (i = x->s_seq; i != aoi->log_head; i++) {
+            c = _append_list(c, aoi->log[i % AOI_LOG_SIZE].id);
+        }
+    }
+    x->s_seq = aoi->log_head;
+    aoi->log_read = aoi->log_head;
+    qsort(c + 2, c[0], sizeof(int), _aoi_id_cmp);
+    aoi->log_list = c;
+    return all;
+}
+
+/**
+ * Spectator keep objects unchanged from old version list, test changed.
+ * Object held by dwell is out of sight, dwell keep it until expired.
+ */
+static void
+_aoi_scan_log(struct aoi *aoi, struct aoi_scan *s) {
+    struct aoi_object *obj = s->obj;
+    int all = _aoi_log_collect(aoi, s);
+    int *o = obj->o_list, *c = aoi->log_list, *h = s->x->h_list[0];
+    int o_i = 2, c_i = 2, h_i = 0;
+    int h_cnt = s->x->dwell > 0 ? h[0] : 0;
+    while (o_i < o[0] + 2 || c_i < c[0] + 2) {
+        struct aoi_object *p;
+        int id, dx, dy, in;
+        if (c_i >= c[0] + 2 || (o_i < o[0] + 2 && o[o_i] < c[c_i])) {
+            /** unchanged object keep in sight, gone if test all */
+            id = o[o_i++];
+            while (h_i < h_cnt && h[h_i * 2 + 2] < id) {
+                h_i++;
+            }
+            if (!all && !(h_i < h_cnt && h[h_i * 2 + 2] == id)) {
+                s->list = _append_list(s->list, id);
+            }
+            continue;
+        }
+        id = c[c_i];
+        while (c_i < c[0] + 2 && c[c_i] == id) {
+            c_i++;
+        }
+        in = o_i < o[0] + 2 && o[o_i] == id;
+        o_i += in;
+        p = _aoi_object(aoi, id);
+        if (!p || p == obj || !(s->room & ((uint64_t)1 << p->room))) {
+            continue;
+        }
+        s->work++;
+        dx = p->p[0] - obj->p[0];
+        dy = p->p[1] - obj->p[1];
+        if (_aoi_shape_in(&s->shape, dx, dy, s->enter_r)
+                || (in && _aoi_shape_in(&s->shape, dx, dy, s->leave_r))) {
+            s->list = _append_list(s->list, id);
+        }
+    }
+}
+
+/**
+ * Test large objects by their radius seen from.
+ */
+static void
+_aoi_scan_large(struct aoi *aoi, struct aoi_scan *s) {
+    struct aoi_object *obj = s->obj;
+    int i;
+    for (i = 0; i < aoi->n_large; i++) {
+        struct aoi_object *p = aoi->large[i];
+        int64_t dx = p->p[0] - obj->p[0];
+        int64_t dy = p->p[1] - obj->p[1];
+        int64_t d = dx * dx + dy * dy;
+        int64_t r = _aoi_ext(aoi, p)->vis;
+        if (p == obj || !(s->room & ((uint64_t)1 << p->room))) {
+            continue;
+        }
+        s->work++;
+        if (d <= r * r) {
+            s->list = _insert_list(s->list, p->id);
+        } else {
+            r += s->leave_r - s->enter_r;
+            if (d <= r * r && _find_list(obj->o_list, p->id)) {
+                s->list = _insert_list(s->list, p->id);
+            }
+        }
+    }
+}
+
+/**
+ * Get new version object list around.
+ */
+static int *
+_aoi_trigger_scan(struct aoi *aoi, struct aoi_object *obj, int enter_r,
+                  int leave_r) {
+    struct aoi_ext *x = _aoi_ext(aoi, obj);
+    struct aoi_scan s;
+    AOI_TRACE_BEGIN2(ts);
+
+    s.obj = obj;
+    s.x = x;
+    s.shape = x->shape;
+    s.anchor = x->parent ? x->parent : obj;
+    s.room = aoi->room[obj->room];
+    s.enter_r = AOI_FIX(enter_r);
+    s.leave_r = AOI_FIX(leave_r);
+    s.reach = s.leave_r + aoi->attach_r;
+    s.attach = aoi->n_attach > 0;
+    s.list = obj->n_list;
+    s.list[0] = 0;
+    s.work = 0;
+    s.cells = 0;
+    x->t_tick++;
+    if (x->spectator) {
+        _aoi_scan_log(aoi, &s);
+    } else if (aoi->shed > 0) {
+        _aoi_scan_shed(aoi, &s);
+    } else if (x->leader) {
+        _aoi_scan_group(aoi, &s);
+    } else if (aoi->g_cur >= 0 && (aoi->g_flag & AOI_GRID_HYBRID)) {
+        _aoi_scan_hybrid(aoi, &s);
+    } else if (aoi->g_cur < 0 || _aoi_scan_grid(aoi, &s) < 0) {
+        _aoi_scan_sweep(&s);
+    }
+    if (aoi->n_large > 0) {
+        _aoi_scan_large(aoi, &s);
+    }
+    x->work = s.work;
+
+    if (x->dwell > 0) {
+        s.list = _aoi_dwell_hold(aoi, obj, s.list);
+    }
+    obj->n_list = s.list;
+    AOI_TRACE_END2(aoi, ts, "scan", obj->id);
+    return s.list;
+}
+
+/**
+ * Cursor of intersection and subtraction of old and new version list,
+ * event come out in order of id.
+ */
+static inline void
+_aoi_merge_init(struct aoi_iter *m, struct aoi_object *obj) {
+    m->id = obj->id;
+    m->o_list = obj->o_list;
+    m->n_list = obj->n_list;
+    m->o_i = 2;
+    m->n_i = 2;
+}
+
+static inline int
+_aoi_merge_next(struct aoi *aoi, struct aoi_iter *m, struct aoi_event *ev) {
+    int o_cnt = m->o_list[0];
+    int n_cnt = m->n_list[0];
+    for (;;) {
+        int o, n;
+        if (m->o_i > o_cnt + 1) {
+            if (m->n_i > n_cnt + 1) {
+                return 0;
+            }
+            ev->id = m->n_list[m->n_i++];
+            ev->e = AOI_ENTER;
+            return 1;
+        }
+        if (m->n_i > n_cnt + 1) {
+            ev->id = m->o_list[m->o_i++];
+            ev->e = AOI_LEAVE;
+            return 1;
+        }
+        o = m->o_list[m->o_i];
+        if (!_aoi_object(aoi, o)) {
+            m->o_i++;
+            continue;
+        }
+        n = m->n_list[m->n_i];
+        if (n < o) {
+            ev->id = n;
+            ev->e = AOI_ENTER;
+            m->n_i++;
+            return 1;
+        } else if (n == o) {
+            m->o_i++;
+            m->n_i++;
+        } else {
+            ev->id = o;
+            ev->e = AOI_LEAVE;
+            m->o_i++;
+            return 1;
+        }
+    }
+}
+
+/**
+ * Change list version.
+ */
+static inline void
+_aoi_trigger_commit(struct aoi_object *obj) {
+    int *cur_list = obj->n_list;
+    obj->n_list = obj->o_list;
+    obj->o_list = cur_list;
+}
+
+AOI_API int
+aoi_trigger(struct aoi *aoi, int id, int enter_r, int leave_r,
+            struct aoi_event **list) {
+    struct aoi_object *obj;
+    struct aoi_iter m;
+    int r = 0;
+
+    obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return r;
+    }
+    AOI_TRACE_BEGIN(ts);
+    _aoi_trigger_scan(aoi, obj, enter_r, leave_r);
+    AOI_TRACE_BEGIN2(ts_merge);
+    *list = aoi->elist;
+    _aoi_merge_init(&m, obj);
+    while (_aoi_merge_next(aoi, &m, &(*list)[r])) {
+        r++;
+    }
+    _aoi_trigger_commit(obj);
+    AOI_TRACE_END2(aoi, ts_merge, "merge", id);
+    AOI_TRACE_END(aoi, ts, "trigger", id);
+    return r;
+}
+
+AOI_API int
+aoi_trigger_begin(struct aoi *aoi, int id, int enter_r, int leave_r,
+                  struct aoi_iter *it) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return -1;
+    }
+    _aoi_trigger_scan(aoi, obj, enter_r, leave_r);
+    _aoi_merge_init(it, obj);
+    return 0;
+}
+
+AOI_API int
+aoi_trigger_next(struct aoi *aoi, struct aoi_iter *it, struct aoi_event *ev) {
+    return _aoi_merge_next(aoi, it, ev);
+}
+
+AOI_API void
+aoi_trigger_end(struct aoi *aoi, struct aoi_iter *it) {
+    struct aoi_object *obj = _aoi_object(aoi, it->id);
+    struct aoi_ext *x;
+    int *list, i;
+    if (!obj || obj->n_list != it->n_list) {
+        return;
+    }
+    x = _aoi_ext(aoi, obj);
+    /** spectator test all next time, objects not taken are not logged */
+    if (x->spectator && (it->n_i < it->n_list[0] + 2
+                         || it->o_i < it->o_list[0] + 2)) {
+        x->s_key[5] = aoi->log_epoch - 1;
+    }
+    /** new version up to cursor, old version after it */
+    list = obj->n_list;
+    list[0] = it->n_i - 2;
+    for (i = it->o_i; i < it->o_list[0] + 2; i++) {
+        list = _append_list(list, it->o_list[i]);
+    }
+    obj->n_list = list;
+    _aoi_trigger_commit(obj);
+}
+
+static inline int
+_aoi_pack_varint(unsigned char *buf, int size, uint64_t v) {
+    int n = 0;
+    do {
+        if (n >= size) {
+            return -1;
+        }
+        buf[n++] = (unsigned char)((v & 0x7f) | (v > 0x7f ? 0x80 : 0));
+        v >>= 7;
+    } while (v);
+    return n;
+}
+
+/**
+ * State of the object changed by scan besides new version list.
+ */
+struct aoi_undo {
+    int t_tick;
+    unsigned s_seq;
+    int s_key[6];
+};
+
+static inline void
+_aoi_undo_save(struct aoi_undo *u, struct aoi_ext *x) {
+    u->t_tick = x->t_tick;
+    u->s_seq = x->s_seq;
+    memcpy(u->s_key, x->s_key, sizeof u->s_key);
+}
+
+/**
+ * Restore state before scan, hold list of dwell was swapped by scan and
+ * the old one is still intact.
+ */
+static inline void
+_aoi_undo_load(struct aoi_undo *u, struct aoi_ext *x) {
+    if (x->dwell > 0) {
+        int *h_list = x->h_list[0];
+        x->h_list[0] = x->h_list[1];
+        x->h_list[1] = h_list;
+    }
+    x->t_tick = u->t_tick;
+    x->s_seq = u->s_seq;
+    memcpy(x->s_key, u->s_key, sizeof u->s_key);
+}
+
+/**
+ * Pack events of the object into buf, return size or -1 if buf not enough.
+ */
+static int
+_aoi_pack_events(struct aoi *aoi, struct aoi_iter *m, struct aoi_event *ev,
+                 int64_t d, unsigned char *buf, int size) {
+    int64_t target = -1;
+    int n, sz;
+
+    sz = _aoi_pack_varint(buf, size, ((uint64_t)d << 1) ^ (uint64_t)(d >> 63));
+    if (sz < 0) {
+        return -1;
+    }
+    do {
+        n = _aoi_pack_varint(buf + sz, size - sz,
+                             (uint64_t)(ev->id - target) << 1 | (ev->e == AOI_LEAVE));
+        if (n < 0) {
+            return -1;
+        }
+        sz += n;
+        target = ev->id;
+    } while (_aoi_merge_next(aoi, m, ev));
+    if (sz >= size) {
+        return -1;
+    }
+    buf[sz++] = 0;
+    return sz;
+}
+
+/**
+ * Pack events of the object as a group, return size of group,
+ * 0 if no event, -1 if buffer not enough and nothing changed.
+ */
+static int
+_aoi_trigger_pack(struct aoi *aoi, struct aoi_object *obj, int enter_r,
+                  int leave_r, int prev, unsigned char *buf, int size) {
+    struct aoi_iter m;
+    struct aoi_event ev;
+    struct aoi_undo u;
+    int sz;
+
+    _aoi_undo_save(&u, _aoi_ext(aoi, obj));
+    _aoi_trigger_scan(aoi, obj, enter_r, leave_r);
+    _aoi_merge_init(&m, obj);
+    if (!_aoi_merge_next(aoi, &m, &ev)) {
+        _aoi_trigger_commit(obj);
+        return 0;
+    }
+    sz = _aoi_pack_events(aoi, &m, &ev, (int64_t)obj->id - prev, buf, size);
+    if (sz < 0) {
+        /** retry must see same events and dwell ticks */
+        _aoi_undo_load(&u, _aoi_ext(aoi, obj));
+        return -1;
+    }
+    _aoi_trigger_commit(obj);
+    return sz;
+}
+
+AOI_API int
+aoi_trigger_pack(struct aoi *aoi, int id, int enter_r, int leave_r,
+                 unsigned char *buf, int size) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return 0;
+    }
+    return _aoi_trigger_pack(aoi, obj, enter_r, leave_r, 0, buf, size);
+}
+
+AOI_API int
+aoi_around(struct aoi *aoi, int id, int *list, int n) {
+    struct aoi_object *obj;
+    int i;
+
+    obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return 0;
+    }
+    n = n > obj->n_list[0] ? obj->n_list[0] : n;
+    for (i = 0; i < n; i++) {
+        list[i] = obj->n_list[i];
+    }
+
+    return n;
+}
+
+AOI_API void
+aoi_dwell(struct aoi *aoi, int id, int tick) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    struct aoi_ext *x;
+    int i;
+    if (!obj) {
+        return;
+    }
+    x = _aoi_ext(aoi, obj);
+    for (i = 0; i < 2; i++) {
+        if (!x->h_list[i]) {
+            x->h_list[i] = (int *)malloc((AOI_DEF_AOI * 2 + 2)*sizeof(int));
+            x->h_list[i][0] = 0;
+            x->h_list[i][1] = AOI_DEF_AOI;
+        }
+    }
+    x->dwell = tick > 0 ? tick : 0;
+}
+
+AOI_API void
+aoi_room(struct aoi *aoi, int id, int room) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    if (!obj || room < 0 || room >= AOI_MAX_ROOM) {
+        return;
+    }
+    obj->room = room;
+    _aoi_log(aoi, obj, AOI_CHANGE_MOVE);
+}
+
+AOI_API void
+aoi_room_mask(struct aoi *aoi, int room, uint64_t mask) {
+    if (room < 0 || room >= AOI_MAX_ROOM) {
+        return;
+    }
+    aoi->room[room] = mask;
+    aoi->log_epoch++;
+}
+
+AOI_API void
+aoi_shape(struct aoi *aoi, int id, int shape, int w, int h) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    struct aoi_ext *x;
+    if (!obj || w <= 0 || h <= 0) {
+        return;
+    }
+    if (shape != AOI_SHAPE_CIRCLE && shape != AOI_SHAPE_RECT
+            && shape != AOI_SHAPE_ELLIPSE) {
+        return;
+    }
+    x = _aoi_ext(aoi, obj);
+    x->shape.type = shape;
+    x->shape.w = w;
+    x->shape.h = h;
+    aoi->log_epoch += x->spectator;
+    aoi->gen++;
+}
+
+AOI_API void
+aoi_cone(struct aoi *aoi, int id, float fx, float fy, float angle) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return;
+    }
+    _aoi_shape_cone(&_aoi_ext(aoi, obj)->shape, fx, fy, angle);
+    aoi->log_epoch += _aoi_ext(aoi, obj)->spectator;
+    aoi->gen++;
+}
+
+AOI_API int
+aoi_cone_query(struct aoi *aoi, int id, float fx, float fy, float angle,
+               int r, int *list, int n) {
+    struct aoi_object *obj, *p, *a;
+    struct aoi_shape shape;
+    uint64_t room;
+    int i, c = 0;
+
+    obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return 0;
+    }
+    memset(&shape, 0, sizeof shape);
+    _aoi_shape_cone(&shape, fx, fy, angle);
+    room = aoi->room[obj->room];
+    r = AOI_FIX(r);
+    a = _aoi_ext(aoi, obj)->parent ? _aoi_ext(aoi, obj)->parent : obj;
+    for (i = 0; i < 2; i++) {
+        p = i == 0 ? a : a->next[0];
+        while (p && c < n) {
+            struct aoi_object *t = p;
+            if ((i == 0 ? obj->p[0] - p->p[0] : p->p[0] - obj->p[0])
+                    > r + aoi->attach_r) {
+                break;
+            }
+            /** test object in index then objects attached to it */
+            for (; t && c < n; t = t == p ? p->child : t->sibling) {
+                int dx = t->p[0] - obj->p[0];
+                int dy = t->p[1] - obj->p[1];
+                if (t != obj && (room & ((uint64_t)1 << t->room))
+                        && _aoi_shape_in(&shape, dx, dy, r)) {
+                    list[c++] = t->id;
+                }
+            }
+            p = i == 0 ? p->prev[0] : p->next[0];
+        }
+    }
+    return c;
+}
+
+AOI_API void
+aoi_radius(struct aoi *aoi, int id, int enter_r, int leave_r) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    struct aoi_ext *x;
+    if (!obj) {
+        return;
+    }
+    x = _aoi_ext(aoi, obj);
+    x->r[0] = enter_r;
+    x->r[1] = leave_r;
+}
+
+AOI_API void
+aoi_update_all(struct aoi *aoi, int tick) {
+    int i;
+    AOI_TRACE_BEGIN(ts);
+    if (aoi->g_cur >= 0) {
+        if (aoi->g_rebuild >= 0) {
+            _aoi_grid_step(aoi);
+        } else if (aoi->g_flag & AOI_GRID_AUTO) {
+            _aoi_grid_tune(aoi);
+        }
+    }
+    aoi->n_arrive = 0;
+    for (i = 0; i < aoi->n_alive; i++) {
+        struct aoi_object *obj = aoi->alive[i];
+        if (obj->speed > 0 && obj->n_tick > 0) {
+            int left = obj->n_tick;
+            _aoi_object_update(aoi, obj, tick);
+            if (obj->n_tick <= 0) {
+                struct aoi_arrival *a;
+                if (!aoi->arrive) {
+                    aoi->arrive = (struct aoi_arrival *)malloc(AOI_MAX_AOI
+                                  * sizeof *aoi->arrive);
+                    if (!aoi->arrive) {
+                        continue;
+                    }
+                }
+                a = &aoi->arrive[aoi->n_arrive++];
+                a->id = obj->id;
+                a->tick = aoi->tick + min(left, tick);
+            }
+        }
+    }
+    if (aoi->n_vel > 0) {
+        _aoi_velocity_update(aoi, tick);
+    }
+    aoi->tick += tick;
+    AOI_TRACE_END(aoi, ts, "update_all", aoi->n_alive);
+}
+
+AOI_API int
+aoi_arrivals(struct aoi *aoi, struct aoi_arrival **list) {
+    *list = aoi->arrive;
+    return aoi->n_arrive;
+}
+
+AOI_API void
+aoi_trigger_all(struct aoi *aoi, aoi_trigger_cb cb, void *ud) {
+    int i;
+    AOI_TRACE_BEGIN(ts);
+    for (i = 0; i < aoi->n_alive; i++) {
+        struct aoi_object *obj = aoi->alive[i];
+        struct aoi_ext *x = _aoi_ext(aoi, obj);
+        struct aoi_event *list;
+        int n;
+        if (x->r[0] <= 0) {
+            continue;
+        }
+        n = aoi_trigger(aoi, obj->id, x->r[0], x->r[1], &list);
+        if (n > 0) {
+            cb(ud, obj->id, list, n);
+        }
+    }
+    AOI_TRACE_END(aoi, ts, "trigger_all", aoi->n_alive);
+}
+
+AOI_API int
+aoi_trigger_all_pack(struct aoi *aoi, int *cursor, unsigned char *buf,
+                     int size) {
+    int i, prev = 0, sz = 0;
+    for (i = *cursor; i < aoi->n_alive; i++) {
+        struct aoi_object *obj = aoi->alive[i];
+        struct aoi_ext *x = _aoi_ext(aoi, obj);
+        int n;
+        if (x->r[0] <= 0) {
+            continue;
+        }
+        n = _aoi_trigger_pack(aoi, obj, x->r[0], x->r[1], prev,
+                              buf + sz, size - sz);
+        if (n < 0) {
+            *cursor = i;
+            return sz > 0 ? sz : -1;
+        }
+        if (n > 0) {
+            prev = obj->id;
+            sz += n;
+        }
+    }
+    *cursor = 0;
+    return sz;
+}
+
+AOI_API void
+aoi_trace_dump(struct aoi *aoi, FILE *f) {
+    fprintf(f, "{\"traceEvents\":[");
+#ifdef AOI_TRACE
+    {
+        unsigned int i, first = 0, n = aoi->n_trace;
+        if (n > AOI_TRACE_SIZE) {
+            first = n - AOI_TRACE_SIZE;
+        }
+        for (i = first; i < n; i++) {
+            struct aoi_trace *t = &aoi->trace[i % AOI_TRACE_SIZE];
+            fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"id\":%d}}",
+                    i == first ? "" : ",",
+                    t->name, t->ts / 1e3, t->dur / 1e3, t->id);
+        }
+    }
+#else
+    (void)aoi;
+#endif
+    fprintf(f, "\n]}\n");
+}
+
+AOI_API int
+aoi_density_map(struct aoi *aoi, int x, int y, int cell, int w, int h,
+                struct aoi_density *out) {
+    int i;
+    if (cell <= 0 || w <= 0 || h <= 0) {
+        return 0;
+    }
+    memset(out, 0, w * h * sizeof *out);
+    x = AOI_FIX(x);
+    y = AOI_FIX(y);
+    cell = AOI_FIX(cell);
+    for (i = 0; i < aoi->n_alive; i++) {
+        struct aoi_object *obj = aoi->alive[i];
+        int cx = (obj->p[0] - x) / cell;
+        int cy = (obj->p[1] - y) / cell;
+        struct aoi_density *d;
+        cx = cx < 0 ? 0 : (cx >= w ? w - 1 : cx);
+        cy = cy < 0 ? 0 : (cy >= h ? h - 1 : cy);
+        d = &out[cy * w + cx];
+        d->count++;
+        d->work += _aoi_ext(aoi, obj)->work;
+    }
+    return aoi->n_alive;
+}
+
+AOI_API void
+aoi_shed(struct aoi *aoi, int work) {
+    aoi->shed = work > 0 ? work : 0;
+}
+
+AOI_API int
+aoi_trigger_budget(struct aoi *aoi, int work, int64_t ns, aoi_trigger_cb cb,
+                   void *ud) {
+    int64_t start = ns > 0 ? _aoi_now() : 0;
+    int i, c = 0, w = 0;
+    for (i = 0; i < aoi->n_alive; i++) {
+        struct aoi_object *obj;
+        struct aoi_ext *x;
+        struct aoi_event *list;
+        int n;
+        if (c > 0 && ((work > 0 && w >= work)
+                      || (ns > 0 && _aoi_now() - start >= ns))) {
+            break;
+        }
+        if (aoi->turn >= aoi->n_alive) {
+            aoi->turn = 0;
+        }
+        obj = aoi->alive[aoi->turn++];
+        x = _aoi_ext(aoi, obj);
+        if (x->r[0] <= 0) {
+            continue;
+        }
+        n = aoi_trigger(aoi, obj->id, x->r[0], x->r[1], &list);
+        if (n > 0) {
+            cb(ud, obj->id, list, n);
+        }
+        w += x->work;
+        c++;
+    }
+    return c;
+}
+
+AOI_API void
+aoi_grid(struct aoi *aoi, int cell, int flag) {
+    int i;
+    for (i = 0; i < aoi->n_alive; i++) {
+        _aoi_grid_erase(aoi, aoi->alive[i]);
+    }
+    memset(aoi->grid, 0, sizeof aoi->grid);
+    memset(aoi->g_stat, 0, sizeof aoi->g_stat);
+    memset(aoi->tiles, 0, sizeof aoi->tiles);
+    aoi->g_cur = -1;
+    aoi->g_rebuild = -1;
+    aoi->g_flag = flag;
+    if (cell <= 0) {
+        return;
+    }
+    aoi->g_cur = 0;
+    aoi->grid[0].cell = AOI_FIX(cell);
+    aoi->tile = aoi->grid[0].cell * AOI_TILE_CELL;
+    for (i = 0; i < aoi->n_alive; i++) {
+        if (!_aoi_ext(aoi, aoi->alive[i])->parent) {
+            _aoi_grid_insert(aoi, 0, aoi->alive[i]);
+        }
+    }
+}
+
+AOI_API void
+aoi_group(struct aoi *aoi, int id, int leader) {
+    struct aoi_object *obj, *l;
+    struct aoi_ext *x, *lx;
+    obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return;
+    }
+    _aoi_group_leave(aoi, obj);
+    l = _aoi_object(aoi, leader);
+    if (!l || l == obj) {
+        return;
+    }
+    lx = _aoi_ext(aoi, l);
+    if (!lx->leader) {
+        lx->leader = l;
+    }
+    l = lx->leader;
+    lx = _aoi_ext(aoi, l);
+    x = _aoi_ext(aoi, obj);
+    x->leader = l;
+    x->member = lx->member;
+    lx->member = obj;
+    /** spread of group changed */
+    aoi->gen++;
+}
+
+AOI_API void
+aoi_attach(struct aoi *aoi, int id, int parent, int x, int y) {
+    struct aoi_object *obj, *p;
+    int i;
+    obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return;
+    }
+    _aoi_detach(aoi, obj);
+    p = _aoi_object(aoi, parent);
+    if (!p || p == obj || _aoi_ext(aoi, p)->parent || obj->child) {
+        return;
+    }
+    /** attached object is out of index */
+    for (i = 0; i < 2; i++) {
+        _aoi_list_erase(aoi, i, obj);
+    }
+    _aoi_grid_erase(aoi, obj);
+    _aoi_velocity_erase(aoi, obj);
+    _aoi_ext(aoi, obj)->parent = p;
+    obj->sibling = p->child;
+    p->child = obj;
+    aoi->n_attach++;
+    obj->n_tick = 0;
+    _aoi_attach_offset(aoi, obj, AOI_FIX(x), AOI_FIX(y));
+}
+
+AOI_API void
+aoi_visible(struct aoi *aoi, int id, int r) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    struct aoi_ext *x;
+    if (!obj) {
+        return;
+    }
+    /** spectator test it again */
+    _aoi_log(aoi, obj, AOI_CHANGE_MOVE);
+    if (r <= 0) {
+        _aoi_large_erase(aoi, obj);
+        return;
+    }
+    if (!aoi->large) {
+        aoi->large = (struct aoi_object **)malloc(AOI_MAX_AOI
+                                                  * sizeof *aoi->large);
+        if (!aoi->large) {
+            return;
+        }
+    }
+    x = _aoi_ext(aoi, obj);
+    if (x->vis <= 0) {
+        x->v_idx = aoi->n_large;
+        aoi->large[aoi->n_large++] = obj;
+    }
+    x->vis = AOI_FIX(r);
+}
+
+AOI_API void
+aoi_spectator(struct aoi *aoi, int id, int on) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    struct aoi_ext *x;
+    if (!obj) {
+        return;
+    }
+    x = _aoi_ext(aoi, obj);
+    if (!on == !x->spectator) {
+        return;
+    }
+    x->spectator = !!on;
+    aoi->n_spectator += on ? 1 : -1;
+    /** test all at next trigger */
+    x->s_key[5] = aoi->log_epoch - 1;
+}
+
+AOI_API unsigned
+aoi_change_log(struct aoi *aoi, int on) {
+    if (!on) {
+        aoi->log_readers -= aoi->log_readers > 0;
+        return aoi->log_head;
+    }
+    aoi->log_readers++;
+    /** move logged before is not after the new cursor, log it again */
+    aoi->log_read = aoi->log_head;
+    return aoi->log_head;
+}
+
+AOI_API int
+aoi_changes(struct aoi *aoi, unsigned *cursor, struct aoi_change *list,
+            int n) {
+    int c = 0;
+    if (aoi->log_head - *cursor > AOI_LOG_SIZE) {
+        *cursor = aoi->log_head;
+        return -1;
+    }
+    while (*cursor != aoi->log_head && c < n) {
+        list[c++] = aoi->log[(*cursor)++ % AOI_LOG_SIZE];
+    }
+    if ((int)(*cursor - aoi->log_read) > 0) {
+        aoi->log_read = *cursor;
+    }
+    return c;
+}
+
+AOI_API void
+aoi_motion(struct aoi *aoi, int id, int motion) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    if (!obj) {
+        return;
+    }
+    _aoi_ext(aoi, obj)->motion = motion;
+}
+
+AOI_API void
+aoi_set_velocity(struct aoi *aoi, int id, float vx, float vy) {
+    struct aoi_object *obj = _aoi_object(aoi, id);
+    struct aoi_ext *x;
+    int i;
+    if (!obj) {
+        return;
+    }
+    x = _aoi_ext(aoi, obj);
+    if (x->parent) {
+        return;
+    }
+    if (vx == 0 && vy == 0) {
+        _aoi_velocity_erase(aoi, obj);
+        return;
+    }
+    if (!aoi->vel) {
+        aoi->vel = (struct aoi_object **)malloc(AOI_MAX_AOI
+                                                * sizeof *aoi->vel);
+        aoi->vel_v = (float (*)[2])malloc(AOI_MAX_AOI * sizeof *aoi->vel_v);
+        aoi->vel_p = (float (*)[2])malloc(AOI_MAX_AOI * sizeof *aoi->vel_p);
+        if (!aoi->vel || !aoi->vel_v || !aoi->vel_p) {
+            free(aoi->vel);
+            free(aoi->vel_v);
+            free(aoi->vel_p);
+            aoi->vel = 0;
+            aoi->vel_v = 0;
+            aoi->vel_p = 0;
+            return;
+        }
+    }
+    /** stop destination move */
+    obj->n_tick = 0;
+    if (!x->vel_idx) {
+        i = aoi->n_vel++;
+        aoi->vel[i] = obj;
+        aoi->vel_p[i][0] = (float)obj->p[0];
+        aoi->vel_p[i][1] = (float)obj->p[1];
+        x->vel_idx = i + 1;
+    }
+    i = x->vel_idx - 1;
+    aoi->vel_v[i][0] = AOI_FIX(vx);
+    aoi->vel_v[i][1] = AOI_FIX(vy);
+}
+
+/**
+ * Count pair of two objects if within distance, write it if list not full.
+ */
+static inline int
+_aoi_pair(struct aoi *aoi, struct aoi_object *a, struct aoi_object *b,
+          int64_t rr, struct aoi_pair *list, int n, int c) {
+    int64_t dx = b->p[0] - a->p[0];
+    int64_t dy = b->p[1] - a->p[1];
+    if (dx * dx + dy * dy <= rr
+            && (aoi->room[a->room] & ((uint64_t)1 << b->room))
+            && (aoi->room[b->room] & ((uint64_t)1 << a->room))) {
+        if (c < n) {
+            list[c].a = a->id;
+            list[c].b = b->id;
+        }
+        c++;
+    }
+    return c;
+}
+
+AOI_API int
+aoi_pairs(struct aoi *aoi, int r, struct aoi_pair *list, int n) {
+    struct aoi_object *p, *q, *a, *b;
+    int64_t rr;
+    int reach, c = 0;
+    r = AOI_FIX(r);
+    rr = (int64_t)r * r;
+    /** attached objects of both may be nearer than their parents */
+    reach = r + 2 * aoi->attach_r;
+    for (p = aoi->list[0]; p; p = p->next[0]) {
+        /** object in index and objects attached to it with each other */
+        for (a = p; a; a = a == p ? p->child : a->sibling) {
+            for (b = a == p ? p->child : a->sibling; b; b = b->sibling) {
+                c = _aoi_pair(aoi, a, b, rr, list, n, c);
+            }
+        }
+        for (q = p->next[0]; q; q = q->next[0]) {
+            if (q->p[0] - p->p[0] > reach) {
+                break;
+            }
+            for (a = p; a; a = a == p ? p->child : a->sibling) {
+                for (b = q; b; b = b == q ? q->child : b->sibling) {
+                    c = _aoi_pair(aoi, a, b, rr, list, n, c);
+                }
+            }
+        }
+    }
+    return c;
 }
 
 #endif // AOI_IMPLEMENTATION
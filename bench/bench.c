@@ -0,0 +1,378 @@
+/**
+ * author: zhoukk
+ * link: https://github.com/zhoukk/aoi
+ *
+ * Benchmark of aoi, time of update and trigger per object per tick.
+ *
+ * usage: aoi_bench [-s scenario] [-n objects] [-t ticks] [-w world]
+ *                  [-r enter_r] [-l leave_r] [-b budget] [-T ns]
+ *                  [-g cell] [-G cell] [-H cell] [-m motion] [-p]
+ *                  [-o trace]
+ *
+ * -b work budget of trigger, see aoi_shed.
+ * -T time budget of trigger per tick in nanosecond, see aoi_trigger_budget.
+ * -g grid index with cell size, see aoi_grid.
+ * -G grid index with cell size tuned automatically.
+ * -H grid index with cell size tuned automatically, choose grid or x axis
+ *    list per tile.
+ * -m motion profile of objects, wobble, linear or ease, see aoi_motion.
+ * -p read hardware performance counters of each phase by perf_event_open,
+ *    cycles, instructions, LLC misses and branch misses, linux only.
+ * -o dump traced phases of the last ticks to file in chrome trace format,
+ *    libaoi build with AOI_TRACE.
+ *
+ * scenario:
+ *   random   objects move to random destination over the world
+ *   crowd    most objects gather in a small area of the world
+ *   teleport objects jump to random place every few ticks
+ *   mixed    half objects in a few dense cities, the others in sparse plains
+ */
+
+#include "aoi.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define BENCH_PHASE_UPDATE 0
+#define BENCH_PHASE_TRIGGER 1
+#define BENCH_PHASE_MAX 2
+
+static const char *phase_name[BENCH_PHASE_MAX] = {"update", "trigger"};
+
+#define BENCH_COUNTER_MAX 4
+
+static const char *counter_name[BENCH_COUNTER_MAX] = {
+    "cycles", "instructions", "llc-miss", "branch-miss"
+};
+
+struct perf {
+    int fd[BENCH_COUNTER_MAX];
+    int n;
+    uint64_t v[BENCH_COUNTER_MAX];
+};
+
+struct bench {
+    const char *scenario;
+    int n;
+    int tick;
+    int world;
+    int enter_r;
+    int leave_r;
+    int budget;
+    int64_t budget_ns;
+    int cell;
+    int grid_flag;
+    int motion;
+    int *ids;
+    long events;
+    double ns[BENCH_PHASE_MAX];
+    int perf;
+    const char *trace;
+    double counter[BENCH_PHASE_MAX][BENCH_COUNTER_MAX];
+};
+
+#ifdef __linux__
+static int
+_perf_open(struct perf *pf) {
+    static const uint64_t config[BENCH_COUNTER_MAX] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    int i;
+
+    memset(pf, 0, sizeof *pf);
+    for (i = 0; i < BENCH_COUNTER_MAX; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof attr);
+        attr.size = sizeof attr;
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config[i];
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        pf->fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1,
+                                 i == 0 ? -1 : pf->fd[0], 0);
+        if (pf->fd[i] < 0) {
+            while (i-- > 0) {
+                close(pf->fd[i]);
+            }
+            return -1;
+        }
+    }
+    pf->n = BENCH_COUNTER_MAX;
+    ioctl(pf->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(pf->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return 0;
+}
+
+static void
+_perf_read(struct perf *pf) {
+    uint64_t buf[BENCH_COUNTER_MAX + 1];
+    int i;
+    if (pf->n == 0) {
+        return;
+    }
+    if (read(pf->fd[0], buf, sizeof buf) != (ssize_t)sizeof buf) {
+        return;
+    }
+    for (i = 0; i < pf->n; i++) {
+        pf->v[i] = buf[i + 1];
+    }
+}
+
+static void
+_perf_close(struct perf *pf) {
+    int i;
+    for (i = 0; i < pf->n; i++) {
+        close(pf->fd[i]);
+    }
+    pf->n = 0;
+}
+#else
+static int
+_perf_open(struct perf *pf) {
+    memset(pf, 0, sizeof *pf);
+    errno = ENOSYS;
+    return -1;
+}
+
+static void
+_perf_read(struct perf *pf) {
+    (void)pf;
+}
+
+static void
+_perf_close(struct perf *pf) {
+    (void)pf;
+}
+#endif
+
+/**
+ * Read counters at the end of phase, add difference from last read.
+ */
+static void
+_perf_phase(struct bench *b, struct perf *pf, int phase) {
+    uint64_t v[BENCH_COUNTER_MAX];
+    int i;
+    if (pf->n == 0) {
+        return;
+    }
+    memcpy(v, pf->v, sizeof v);
+    _perf_read(pf);
+    for (i = 0; i < pf->n; i++) {
+        b->counter[phase][i] += (double)(pf->v[i] - v[i]);
+    }
+}
+
+static double
+_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+_event(void *ud, int id, struct aoi_event *list, int n) {
+    struct bench *b = (struct bench *)ud;
+    (void)id;
+    (void)list;
+    b->events += n;
+}
+
+static void
+_place(struct bench *b, int *x, int *y) {
+    if (!strcmp(b->scenario, "crowd") && rand() % 10 < 8) {
+        int c = b->world / 16 + 1;
+        *x = b->world / 2 + rand() % c;
+        *y = b->world / 2 + rand() % c;
+    } else if (!strcmp(b->scenario, "mixed") && rand() % 2) {
+        /** cities on the diagonal of the world */
+        int c = b->world / 32 + 1;
+        int city = rand() % 4;
+        *x = b->world * (city * 2 + 1) / 8 + rand() % c;
+        *y = b->world * (city * 2 + 1) / 8 + rand() % c;
+    } else {
+        *x = rand() % b->world;
+        *y = rand() % b->world;
+    }
+}
+
+static void
+_step(struct aoi *aoi, struct bench *b, int t) {
+    int i;
+    for (i = 0; i < b->n; i++) {
+        int x, y;
+        if (!strcmp(b->scenario, "teleport")) {
+            if ((i + t) % 8 == 0) {
+                _place(b, &x, &y);
+                aoi_locate(aoi, b->ids[i], x, y);
+            }
+        } else if (!aoi_moving(aoi, b->ids[i])) {
+            _place(b, &x, &y);
+            aoi_move(aoi, b->ids[i], x, y);
+        }
+    }
+}
+
+static int
+_run(struct bench *b) {
+    struct aoi *aoi;
+    struct perf pf;
+    int i, t;
+
+    aoi = (struct aoi *)malloc(aoi_memsize());
+    if (!aoi) {
+        return -1;
+    }
+    aoi_init(aoi);
+    aoi_shed(aoi, b->budget);
+    aoi_grid(aoi, b->cell, b->grid_flag);
+    b->ids = (int *)malloc(b->n * sizeof(int));
+    srand(1);
+    for (i = 0; i < b->n; i++) {
+        int x, y;
+        b->ids[i] = aoi_enter(aoi, 0);
+        _place(b, &x, &y);
+        aoi_speed(aoi, b->ids[i], rand() % 10 + 4);
+        aoi_motion(aoi, b->ids[i], b->motion);
+        aoi_locate(aoi, b->ids[i], x, y);
+        aoi_radius(aoi, b->ids[i], b->enter_r, b->leave_r);
+    }
+    memset(&pf, 0, sizeof pf);
+    if (b->perf && _perf_open(&pf)) {
+        fprintf(stderr, "perf_event_open: %s, counters disabled\n",
+                strerror(errno));
+        b->perf = 0;
+    }
+    for (t = 0; t < b->tick; t++) {
+        double t0, t1, t2;
+        _step(aoi, b, t);
+        _perf_read(&pf);
+        t0 = _now();
+        aoi_update_all(aoi, 1);
+        t1 = _now();
+        _perf_phase(b, &pf, BENCH_PHASE_UPDATE);
+        if (b->budget_ns > 0) {
+            aoi_trigger_budget(aoi, 0, b->budget_ns, _event, b);
+        } else {
+            aoi_trigger_all(aoi, _event, b);
+        }
+        t2 = _now();
+        _perf_phase(b, &pf, BENCH_PHASE_TRIGGER);
+        b->ns[BENCH_PHASE_UPDATE] += t1 - t0;
+        b->ns[BENCH_PHASE_TRIGGER] += t2 - t1;
+    }
+    _perf_close(&pf);
+    if (b->trace) {
+        FILE *f = fopen(b->trace, "w");
+        if (f) {
+            aoi_trace_dump(aoi, f);
+            fclose(f);
+        }
+    }
+    aoi_unit(aoi);
+    free(aoi);
+    free(b->ids);
+    return 0;
+}
+
+static void
+_report(struct bench *b) {
+    double per = (double)b->n * b->tick;
+    int i, j;
+    printf("scenario: %s objects: %d ticks: %d world: %d radius: %d/%d"
+           " budget: %d cell: %d\n", b->scenario, b->n, b->tick, b->world,
+           b->enter_r, b->leave_r, b->budget, b->cell);
+    for (i = 0; i < BENCH_PHASE_MAX; i++) {
+        printf("  %-8s %10.1f ns/object/tick %10.3f ms/tick\n", phase_name[i],
+               b->ns[i] / per, b->ns[i] / b->tick / 1e6);
+        for (j = 0; b->perf && j < BENCH_COUNTER_MAX; j++) {
+            printf("    %-12s %10.2f /object/tick\n", counter_name[j],
+                   b->counter[i][j] / per);
+        }
+    }
+    printf("  events   %10.2f /object/tick\n", b->events / per);
+}
+
+int
+main(int argc, char *argv[]) {
+    struct bench b;
+    int i;
+
+    memset(&b, 0, sizeof b);
+    b.scenario = "random";
+    b.n = 10000;
+    b.tick = 100;
+    b.world = 10000;
+    b.enter_r = 100;
+    b.leave_r = 130;
+    for (i = 1; i < argc; i += 2) {
+        if (!strcmp(argv[i], "-p")) {
+            b.perf = 1;
+            i--;
+        } else if (i + 1 >= argc) {
+            fprintf(stderr, "missing value of option %s\n", argv[i]);
+            return 1;
+        } else if (!strcmp(argv[i], "-s")) {
+            b.scenario = argv[i + 1];
+        } else if (!strcmp(argv[i], "-n")) {
+            b.n = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-t")) {
+            b.tick = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-w")) {
+            b.world = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-r")) {
+            b.enter_r = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-l")) {
+            b.leave_r = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-b")) {
+            b.budget = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-T")) {
+            b.budget_ns = atoll(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-g")) {
+            b.cell = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-G")) {
+            b.cell = atoi(argv[i + 1]);
+            b.grid_flag = AOI_GRID_AUTO;
+        } else if (!strcmp(argv[i], "-H")) {
+            b.cell = atoi(argv[i + 1]);
+            b.grid_flag = AOI_GRID_AUTO | AOI_GRID_HYBRID;
+        } else if (!strcmp(argv[i], "-m")) {
+            if (!strcmp(argv[i + 1], "linear")) {
+                b.motion = AOI_MOTION_LINEAR;
+            } else if (!strcmp(argv[i + 1], "ease")) {
+                b.motion = AOI_MOTION_EASE;
+            } else {
+                b.motion = AOI_MOTION_WOBBLE;
+            }
+        } else if (!strcmp(argv[i], "-o")) {
+            b.trace = argv[i + 1];
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (b.n <= 0 || b.n > AOI_MAX_AOI || b.tick <= 0 || b.world <= 0) {
+        fprintf(stderr, "invalid option\n");
+        return 1;
+    }
+    if (_run(&b)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    _report(&b);
+    return 0;
+}
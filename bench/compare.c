@@ -0,0 +1,101 @@
+/**
+ * author: zhoukk
+ * link: https://github.com/zhoukk/aoi
+ *
+ * Benchmark of the integer api shared by all versions of aoi.h, build it
+ * with an older aoi.h to compare speed, see AOI_BASELINE of cmake.
+ *
+ * usage: aoi_compare [-n objects] [-t ticks] [-w world] [-r enter_r]
+ *                    [-l leave_r]
+ *
+ * objects move to random destination over the world, each object updated
+ * and triggered one by one.
+ */
+
+#define AOI_IMPLEMENTATION
+#include "aoi.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double
+_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int
+main(int argc, char *argv[]) {
+    int n = 10000, tick = 100, world = 10000, enter_r = 100, leave_r = 130;
+    double ns[2] = {0, 0}, per;
+    long events = 0;
+    struct aoi *aoi;
+    int *ids, i, t;
+
+    for (i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "-n")) {
+            n = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-t")) {
+            tick = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-w")) {
+            world = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-r")) {
+            enter_r = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-l")) {
+            leave_r = atoi(argv[i + 1]);
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (i < argc || n <= 0 || n > AOI_MAX_AOI || tick <= 0 || world <= 0) {
+        fprintf(stderr, "invalid option\n");
+        return 1;
+    }
+    aoi = (struct aoi *)malloc(aoi_memsize());
+    ids = (int *)malloc(n * sizeof(int));
+    if (!aoi || !ids) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    aoi_init(aoi);
+    srand(1);
+    for (i = 0; i < n; i++) {
+        ids[i] = aoi_enter(aoi, 0);
+        aoi_speed(aoi, ids[i], rand() % 10 + 4);
+        aoi_locate(aoi, ids[i], rand() % world, rand() % world);
+    }
+    for (t = 0; t < tick; t++) {
+        double t0, t1, t2;
+        for (i = 0; i < n; i++) {
+            if (!aoi_moving(aoi, ids[i])) {
+                aoi_move(aoi, ids[i], rand() % world, rand() % world);
+            }
+        }
+        t0 = _now();
+        for (i = 0; i < n; i++) {
+            aoi_update(aoi, ids[i], 1);
+        }
+        t1 = _now();
+        for (i = 0; i < n; i++) {
+            struct aoi_event *list;
+            events += aoi_trigger(aoi, ids[i], enter_r, leave_r, &list);
+        }
+        t2 = _now();
+        ns[0] += t1 - t0;
+        ns[1] += t2 - t1;
+    }
+    per = (double)n * tick;
+    printf("objects: %d ticks: %d world: %d radius: %d/%d\n", n, tick, world,
+           enter_r, leave_r);
+    printf("  update   %10.1f ns/object/tick\n", ns[0] / per);
+    printf("  trigger  %10.1f ns/object/tick\n", ns[1] / per);
+    printf("  events   %10.2f /object/tick\n", events / per);
+    aoi_unit(aoi);
+    free(aoi);
+    free(ids);
+    return 0;
+}
@@ -0,0 +1,247 @@
+/**
+ * author: zhoukk
+ * link: https://github.com/zhoukk/aoi
+ *
+ * Lua binding of aoi, batch call cut Lua/C boundary crossing.
+ *
+ * build: gcc -O2 -shared -fPIC lua-aoi.c -o aoi.so -lm
+ *
+ * example:
+ *
+ * local aoi = require "aoi"
+ * local space = aoi.new()
+ * local id = space:enter()
+ * space:speed(id, 5)
+ * space:locate(id, 100, 100)
+ * space:radius(id, 100, 130)
+ * space:move(id, 500, 300)
+ * space:update_all(1)
+ * local events, n = space:trigger_all()
+ * local pos = 1
+ * for i = 1, n do
+ *     local watcher, target, e
+ *     watcher, target, e, pos = string.unpack("=i4i4i4", events, pos)
+ * end
+ *
+ */
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#define AOI_IMPLEMENTATION
+#include "aoi.h"
+
+#define METANAME "aoi"
+
+static struct aoi *
+_check(lua_State *L) {
+    return (struct aoi *)luaL_checkudata(L, 1, METANAME);
+}
+
+static int
+_new(lua_State *L) {
+    struct aoi *aoi = (struct aoi *)lua_newuserdata(L, aoi_memsize());
+    aoi_init(aoi);
+    luaL_setmetatable(L, METANAME);
+    return 1;
+}
+
+static int
+_gc(lua_State *L) {
+    aoi_unit(_check(L));
+    return 0;
+}
+
+static int
+_enter(lua_State *L) {
+    lua_pushinteger(L, aoi_enter(_check(L), 0));
+    return 1;
+}
+
+static int
+_leave(lua_State *L) {
+    aoi_leave(_check(L), (int)luaL_checkinteger(L, 2));
+    return 0;
+}
+
+static int
+_locate(lua_State *L) {
+    aoi_locatef(_check(L), (int)luaL_checkinteger(L, 2),
+                (float)luaL_checknumber(L, 3), (float)luaL_checknumber(L, 4));
+    return 0;
+}
+
+static int
+_move(lua_State *L) {
+    aoi_movef(_check(L), (int)luaL_checkinteger(L, 2),
+              (float)luaL_checknumber(L, 3), (float)luaL_checknumber(L, 4));
+    return 0;
+}
+
+static int
+_speed(lua_State *L) {
+    aoi_speedf(_check(L), (int)luaL_checkinteger(L, 2),
+               (float)luaL_checknumber(L, 3));
+    return 0;
+}
+
+static int
+_velocity(lua_State *L) {
+    aoi_set_velocity(_check(L), (int)luaL_checkinteger(L, 2),
+                     (float)luaL_checknumber(L, 3),
+                     (float)luaL_checknumber(L, 4));
+    return 0;
+}
+
+static int
+_radius(lua_State *L) {
+    aoi_radius(_check(L), (int)luaL_checkinteger(L, 2),
+               (int)luaL_checkinteger(L, 3), (int)luaL_checkinteger(L, 4));
+    return 0;
+}
+
+static int
+_pos(lua_State *L) {
+    float x = 0, y = 0;
+    aoi_posf(_check(L), (int)luaL_checkinteger(L, 2), &x, &y);
+    lua_pushnumber(L, x);
+    lua_pushnumber(L, y);
+    return 2;
+}
+
+static int
+_moving(lua_State *L) {
+    lua_pushboolean(L, aoi_moving(_check(L), (int)luaL_checkinteger(L, 2)));
+    return 1;
+}
+
+static int
+_update(lua_State *L) {
+    aoi_update(_check(L), (int)luaL_checkinteger(L, 2),
+               (int)luaL_optinteger(L, 3, 1));
+    return 0;
+}
+
+/**
+ * Locate objects in batch, arg is a string packed by int32 id, x, y.
+ */
+static int
+_locate_all(lua_State *L) {
+    struct aoi *aoi = _check(L);
+    size_t sz, i;
+    const int *p = (const int *)luaL_checklstring(L, 2, &sz);
+    sz /= 3 * sizeof(int);
+    for (i = 0; i < sz; i++) {
+        aoi_locate(aoi, p[i * 3], p[i * 3 + 1], p[i * 3 + 2]);
+    }
+    return 0;
+}
+
+static int
+_update_all(lua_State *L) {
+    aoi_update_all(_check(L), (int)luaL_optinteger(L, 2, 1));
+    return 0;
+}
+
+/**
+ * Objects arrived in last update_all, return a string packed by
+ * int32 id, tick and count of arrivals.
+ */
+static int
+_arrivals(lua_State *L) {
+    struct aoi_arrival *list;
+    int n = aoi_arrivals(_check(L), &list);
+    lua_pushlstring(L, (const char *)list, n * sizeof *list);
+    lua_pushinteger(L, n);
+    return 2;
+}
+
+struct pack {
+    luaL_Buffer b;
+    int n;
+};
+
+static void
+_pack_cb(void *ud, int id, struct aoi_event *list, int n) {
+    struct pack *pk = (struct pack *)ud;
+    int i;
+    for (i = 0; i < n; i++) {
+        int e[3];
+        e[0] = id;
+        e[1] = list[i].id;
+        e[2] = list[i].e;
+        luaL_addlstring(&pk->b, (const char *)e, sizeof e);
+    }
+    pk->n += n;
+}
+
+static int
+_trigger(lua_State *L) {
+    struct aoi *aoi = _check(L);
+    int id = (int)luaL_checkinteger(L, 2);
+    struct aoi_event *list;
+    struct pack pk;
+    int n;
+    n = aoi_trigger(aoi, id, (int)luaL_checkinteger(L, 3),
+                    (int)luaL_checkinteger(L, 4), &list);
+    pk.n = 0;
+    luaL_buffinit(L, &pk.b);
+    _pack_cb(&pk, id, list, n);
+    luaL_pushresult(&pk.b);
+    lua_pushinteger(L, pk.n);
+    return 2;
+}
+
+/**
+ * Trigger all objects with radius, return a string packed by
+ * int32 watcher, target, event and count of events.
+ */
+static int
+_trigger_all(lua_State *L) {
+    struct aoi *aoi = _check(L);
+    struct pack pk;
+    pk.n = 0;
+    luaL_buffinit(L, &pk.b);
+    aoi_trigger_all(aoi, _pack_cb, &pk);
+    luaL_pushresult(&pk.b);
+    lua_pushinteger(L, pk.n);
+    return 2;
+}
+
+LUAMOD_API int
+luaopen_aoi(lua_State *L) {
+    luaL_Reg l[] = {
+        {"enter", _enter},
+        {"leave", _leave},
+        {"locate", _locate},
+        {"move", _move},
+        {"speed", _speed},
+        {"velocity", _velocity},
+        {"radius", _radius},
+        {"pos", _pos},
+        {"moving", _moving},
+        {"update", _update},
+        {"trigger", _trigger},
+        {"locate_all", _locate_all},
+        {"update_all", _update_all},
+        {"arrivals", _arrivals},
+        {"trigger_all", _trigger_all},
+        {0, 0},
+    };
+    luaL_checkversion(L);
+    luaL_newmetatable(L, METANAME);
+    luaL_newlib(L, l);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, _gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    lua_pushcfunction(L, _new);
+    lua_setfield(L, -2, "new");
+    lua_pushinteger(L, AOI_ENTER);
+    lua_setfield(L, -2, "ENTER");
+    lua_pushinteger(L, AOI_LEAVE);
+    lua_setfield(L, -2, "LEAVE");
+    return 1;
+}
@@ -0,0 +1,854 @@
+/**
+ * author: zhoukk
+ * link: https://github.com/zhoukk/aoi
+ *
+ * Test of aoi, each feature checked against plain trigger or known result.
+ *
+ * usage: aoi_test
+ */
+
+#include "aoi.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failed;
+
+#define CHECK(c) do {\
+        if (!(c)) {\
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #c);\
+            failed++;\
+        }\
+    } while (0)
+
+static struct aoi *
+new_aoi(void) {
+    struct aoi *aoi = (struct aoi *)malloc(aoi_memsize());
+    aoi_init(aoi);
+    return aoi;
+}
+
+static void
+free_aoi(struct aoi *aoi) {
+    aoi_unit(aoi);
+    free(aoi);
+}
+
+static int
+enter_at(struct aoi *aoi, int x, int y) {
+    int id = aoi_enter(aoi, 0);
+    aoi_locate(aoi, id, x, y);
+    return id;
+}
+
+/** Event of target in trigger of id, 0 if none. */
+static int
+event_of(struct aoi *aoi, int id, int enter_r, int leave_r, int target) {
+    struct aoi_event *list;
+    int n = aoi_trigger(aoi, id, enter_r, leave_r, &list);
+    int i, e = 0;
+    for (i = 0; i < n; i++) {
+        if (list[i].id == target) {
+            e = list[i].e;
+        }
+    }
+    return e;
+}
+
+static void
+test_trigger(void) {
+    struct aoi *aoi = new_aoi();
+    int w = enter_at(aoi, 0, 0);
+    int t = enter_at(aoi, 90, 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == AOI_ENTER);
+    /** inside leave radius, stay in sight */
+    aoi_locate(aoi, t, 120, 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == 0);
+    aoi_locate(aoi, t, 140, 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == AOI_LEAVE);
+    aoi_locate(aoi, t, 90, 0);
+    aoi_leave(aoi, t);
+    CHECK(event_of(aoi, w, 100, 130, t) == 0);
+    free_aoi(aoi);
+}
+
+static void
+test_dwell(void) {
+    struct aoi *aoi = new_aoi();
+    int w = enter_at(aoi, 0, 0);
+    int t = enter_at(aoi, 50, 0);
+    aoi_dwell(aoi, w, 2);
+    CHECK(event_of(aoi, w, 100, 130, t) == AOI_ENTER);
+    aoi_locate(aoi, t, 500, 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == AOI_LEAVE);
+    aoi_locate(aoi, t, 50, 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == AOI_ENTER);
+    aoi_locate(aoi, t, 500, 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == 0);
+    /** back in sight within dwell, no event */
+    aoi_locate(aoi, t, 50, 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == 0);
+    free_aoi(aoi);
+}
+
+static void
+test_dwell_spectator(void) {
+    struct aoi *aoi = new_aoi();
+    int w = enter_at(aoi, 0, 0);
+    int t = enter_at(aoi, 50, 0);
+    aoi_spectator(aoi, w, 1);
+    aoi_dwell(aoi, w, 2);
+    CHECK(event_of(aoi, w, 100, 130, t) == AOI_ENTER);
+    aoi_locate(aoi, t, 500, 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == AOI_LEAVE);
+    CHECK(event_of(aoi, w, 100, 130, t) == 0);
+    aoi_locate(aoi, t, 50, 0);
+    CHECK(event_of(aoi, w, 100, 130, t) == AOI_ENTER);
+    free_aoi(aoi);
+}
+
+static void
+test_room(void) {
+    struct aoi *aoi = new_aoi();
+    int a = enter_at(aoi, 0, 0);
+    int b = enter_at(aoi, 10, 0);
+    aoi_room(aoi, a, 1);
+    aoi_room(aoi, b, 2);
+    aoi_room_mask(aoi, 1, (uint64_t)1 << 1);
+    CHECK(event_of(aoi, a, 100, 130, b) == 0);
+    CHECK(event_of(aoi, b, 100, 130, a) == AOI_ENTER);
+    aoi_room_mask(aoi, 1, ~(uint64_t)0);
+    CHECK(event_of(aoi, a, 100, 130, b) == AOI_ENTER);
+    free_aoi(aoi);
+}
+
+static void
+test_shape(void) {
+    struct aoi *aoi = new_aoi();
+    int w = enter_at(aoi, 0, 0);
+    int t = enter_at(aoi, 90, 0);
+    int u = enter_at(aoi, 0, 90);
+    int v = enter_at(aoi, -50, 0);
+    int list[8];
+    aoi_shape(aoi, w, AOI_SHAPE_RECT, 2, 1);
+    CHECK(event_of(aoi, w, 100, 100, t) == AOI_ENTER);
+    /** u out of rect, enter after changed to circle */
+    aoi_shape(aoi, w, AOI_SHAPE_ELLIPSE, 1, 1);
+    CHECK(event_of(aoi, w, 100, 100, u) == AOI_ENTER);
+    aoi_shape(aoi, w, AOI_SHAPE_RECT, 2, 1);
+    CHECK(event_of(aoi, w, 100, 100, u) == AOI_LEAVE);
+    /** cone without facing is not a shape, rect kept */
+    aoi_shape(aoi, w, AOI_SHAPE_CONE, 1, 1);
+    aoi_shape(aoi, w, 7, 1, 1);
+    CHECK(event_of(aoi, w, 100, 100, u) == 0);
+    aoi_shape(aoi, w, AOI_SHAPE_CIRCLE, 1, 1);
+    CHECK(event_of(aoi, w, 100, 100, u) == AOI_ENTER);
+    aoi_cone(aoi, w, 1, 0, 0.5f);
+    CHECK(event_of(aoi, w, 100, 100, u) == AOI_LEAVE);
+    CHECK(aoi_cone_query(aoi, w, -1, 0, 0.5f, 100, list, 8) == 1);
+    CHECK(list[0] == v);
+    free_aoi(aoi);
+}
+
+/** Decode packed stream into events, return count. */
+static int
+unpack(const unsigned char *buf, int size, int *owner, struct aoi_event *list) {
+    int i = 0, n = 0, id = 0;
+    while (i < size) {
+        uint64_t v = 0;
+        int s = 0, target = -1;
+        do {
+            v |= (uint64_t)(buf[i] & 0x7f) << s;
+            s += 7;
+        } while (buf[i++] & 0x80);
+        id += (int)(v >> 1) ^ -(int)(v & 1);
+        while (buf[i] != 0) {
+            v = 0;
+            s = 0;
+            do {
+                v |= (uint64_t)(buf[i] & 0x7f) << s;
+                s += 7;
+            } while (buf[i++] & 0x80);
+            target += (int)(v >> 1);
+            owner[n] = id;
+            list[n].id = target;
+            list[n].e = v & 1 ? AOI_LEAVE : AOI_ENTER;
+            n++;
+        }
+        i++;
+    }
+    return n;
+}
+
+static void
+test_pack(void) {
+    struct aoi *a = new_aoi(), *b = new_aoi();
+    unsigned char buf[4096];
+    int owner[256];
+    struct aoi_event ev[256];
+    int ids[16], i, j, n, sz, cursor = 0, c = 0;
+    for (i = 0; i < 16; i++) {
+        ids[i] = enter_at(a, i * 20, i % 3 * 20);
+        enter_at(b, i * 20, i % 3 * 20);
+        aoi_radius(b, ids[i], 50, 60);
+    }
+    /** no room for one group, nothing changed and it can be retried */
+    CHECK(aoi_trigger_pack(b, ids[0], 50, 60, buf, 1) == -1);
+    CHECK(aoi_trigger_all_pack(b, &cursor, buf, 1) == -1);
+    sz = aoi_trigger_all_pack(b, &cursor, buf, sizeof buf);
+    CHECK(sz > 0 && cursor == 0);
+    n = unpack(buf, sz, owner, ev);
+    for (i = 0; i < 16; i++) {
+        struct aoi_event *list;
+        int r = aoi_trigger(a, ids[i], 50, 60, &list);
+        for (j = 0; j < r; j++, c++) {
+            CHECK(c < n && owner[c] == ids[i] && ev[c].id == list[j].id
+                  && ev[c].e == list[j].e);
+        }
+    }
+    CHECK(c == n);
+    free_aoi(a);
+    free_aoi(b);
+}
+
+/** Pack trigger of id, event of target, 0 if none, fail first if retry. */
+static int
+packed_event_of(struct aoi *aoi, int id, int target, int retry) {
+    unsigned char buf[256];
+    int owner[64];
+    struct aoi_event ev[64];
+    int i, n, sz, e = 0;
+    if (retry) {
+        CHECK(aoi_trigger_pack(aoi, id, 100, 130, buf, 1) == -1);
+    }
+    sz = aoi_trigger_pack(aoi, id, 100, 130, buf, sizeof buf);
+    n = unpack(buf, sz > 0 ? sz : 0, owner, ev);
+    for (i = 0; i < n; i++) {
+        if (ev[i].id == target) {
+            e = ev[i].e;
+        }
+    }
+    return e;
+}
+
+static void
+test_pack_retry(void) {
+    struct aoi *aoi = new_aoi();
+    int w = enter_at(aoi, 0, 0);
+    int t = enter_at(aoi, 50, 0);
+    int s = enter_at(aoi, 1000, 0);
+    aoi_dwell(aoi, w, 2);
+    aoi_spectator(aoi, s, 1);
+    CHECK(packed_event_of(aoi, w, t, 1) == AOI_ENTER);
+    CHECK(packed_event_of(aoi, s, t, 0) == 0);
+    aoi_locate(aoi, t, 500, 0);
+    CHECK(packed_event_of(aoi, w, t, 0) == 0);
+    CHECK(packed_event_of(aoi, w, t, 0) == 0);
+    /** failed pack not count as tick of dwell */
+    CHECK(packed_event_of(aoi, w, t, 1) == AOI_LEAVE);
+    /** spectator see change logged before the failed pack */
+    aoi_locate(aoi, t, 950, 0);
+    CHECK(packed_event_of(aoi, s, t, 1) == AOI_ENTER);
+    free_aoi(aoi);
+}
+
+/** Linear congruential random, same sequence for aoi in lockstep. */
+static unsigned
+next_rand(unsigned *seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return (*seed >> 16) & 0x7fff;
+}
+
+/**
+ * Objects walk randomly in two aoi, the first one configured by base if
+ * any, the second one by setup, events of every trigger must be same.
+ * Some objects also move between triggers of others.
+ */
+static void
+check_same(int n, int ticks, void (*base)(struct aoi *aoi, int *ids, int n),
+           void (*setup)(struct aoi *aoi, int *ids, int n)) {
+    struct aoi *a = new_aoi(), *b = new_aoi();
+    int *ids = (int *)malloc(n * sizeof(int));
+    unsigned seed = 7;
+    int i, t;
+    for (i = 0; i < n; i++) {
+        int x = next_rand(&seed) % 600, y = next_rand(&seed) % 600;
+        ids[i] = enter_at(a, x, y);
+        CHECK(enter_at(b, x, y) == ids[i]);
+    }
+    if (base) {
+        base(a, ids, n);
+        base(b, ids, n);
+    }
+    setup(b, ids, n);
+    for (t = 0; t < ticks; t++) {
+        for (i = 0; i < n; i++) {
+            struct aoi_event *la, *lb;
+            int na = aoi_trigger(a, ids[i], 100, 130, &la);
+            int nb = aoi_trigger(b, ids[i], 100, 130, &lb);
+            CHECK(na == nb && memcmp(la, lb, na * sizeof *la) == 0);
+            if (next_rand(&seed) % 8 == 0) {
+                int j = next_rand(&seed) % n;
+                int x = next_rand(&seed) % 600, y = next_rand(&seed) % 600;
+                aoi_locate(a, ids[j], x, y);
+                aoi_locate(b, ids[j], x, y);
+            }
+        }
+        for (i = 0; i < n; i++) {
+            int x, y;
+            if (next_rand(&seed) % 4) {
+                continue;
+            }
+            aoi_pos(a, ids[i], &x, &y);
+            x += next_rand(&seed) % 81 - 40;
+            y += next_rand(&seed) % 81 - 40;
+            aoi_locate(a, ids[i], x, y);
+            aoi_locate(b, ids[i], x, y);
+        }
+    }
+    free(ids);
+    free_aoi(a);
+    free_aoi(b);
+}
+
+static void
+test_density(void) {
+    struct aoi *aoi = new_aoi();
+    struct aoi_density d[6];
+    struct aoi_event *list;
+    int ids[5], i, work = 0;
+    ids[0] = enter_at(aoi, 50, 50);
+    ids[1] = enter_at(aoi, 60, 900);
+    ids[2] = enter_at(aoi, 1000, 50);
+    ids[3] = enter_at(aoi, -500, -500);
+    ids[4] = enter_at(aoi, 250, 150);
+    /** only first two are within x band of each other, one test each */
+    for (i = 0; i < 5; i++) {
+        aoi_trigger(aoi, ids[i], 100, 130, &list);
+    }
+    CHECK(aoi_density_map(aoi, 0, 0, 100, 3, 2, d) == 5);
+    /** out of map counted in nearest edge cell */
+    CHECK(d[0].count == 2 && d[0].work == 1);
+    CHECK(d[1].count == 0 && d[1].work == 0);
+    CHECK(d[2].count == 1 && d[2].work == 0);
+    CHECK(d[3].count == 1 && d[3].work == 1);
+    CHECK(d[4].count == 0);
+    CHECK(d[5].count == 1 && d[5].work == 0);
+    for (i = 0; i < 6; i++) {
+        work += d[i].work;
+    }
+    CHECK(work == 2);
+    CHECK(aoi_density_map(aoi, 0, 0, 0, 3, 2, d) == 0);
+    CHECK(aoi_density_map(aoi, 0, 0, 100, 0, 2, d) == 0);
+    free_aoi(aoi);
+}
+
+static void
+test_shed(void) {
+    struct aoi *aoi = new_aoi();
+    struct aoi_event *list;
+    int w = enter_at(aoi, 0, 0);
+    int ids[20], d[64], i, j, n;
+    unsigned seed = 3;
+    /** objects at same x are all tested, nearest within next x kept */
+    for (i = 0; i < 20; i++) {
+        ids[i] = enter_at(aoi, 0, i + 1);
+    }
+    enter_at(aoi, 10, 0);
+    aoi_shed(aoi, 5);
+    n = aoi_trigger(aoi, w, 100, 130, &list);
+    CHECK(n == 9);
+    for (i = 0; i < n; i++) {
+        CHECK(list[i].id == ids[i] && list[i].e == AOI_ENTER);
+    }
+    free_aoi(aoi);
+
+    /** budget used up in random place, result is the nearest */
+    aoi = new_aoi();
+    w = enter_at(aoi, 200, 200);
+    for (i = 0; i < 64; i++) {
+        int x = next_rand(&seed) % 200 - 100, y = next_rand(&seed) % 200 - 100;
+        enter_at(aoi, 200 + x, 200 + y);
+        d[i] = x * x + y * y;
+    }
+    aoi_shed(aoi, 16);
+    n = aoi_trigger(aoi, w, 100, 130, &list);
+    CHECK(n > 0 && n < 64);
+    for (i = 0; i < 64; i++) {
+        int in = 0;
+        for (j = 0; j < n; j++) {
+            in |= list[j].id == w + 1 + i;
+        }
+        for (j = 0; !in && d[i] <= 100 * 100 && j < n; j++) {
+            CHECK(d[list[j].id - w - 1] <= d[i]);
+        }
+    }
+    free_aoi(aoi);
+}
+
+/** Count triggers of each object, ud is counts indexed by id. */
+static void
+count_trigger(void *ud, int id, struct aoi_event *list, int n) {
+    ((int *)ud)[id]++;
+}
+
+static void
+test_budget(void) {
+    struct aoi *aoi = new_aoi();
+    int ids[10], count[16] = {0}, i, n;
+    for (i = 0; i < 10; i++) {
+        ids[i] = enter_at(aoi, i * 5, 0);
+        CHECK(ids[i] < 16);
+        if (i > 0) {
+            aoi_radius(aoi, ids[i], 100, 130);
+        }
+    }
+    /** budget used up by first watcher, still one each call, rotation
+     * give every watcher its enter events once, object without radius
+     * skipped */
+    for (i = 0; i < 9; i++) {
+        CHECK(aoi_trigger_budget(aoi, 1, 0, count_trigger, count) == 1);
+    }
+    CHECK(count[ids[0]] == 0);
+    for (i = 1; i < 10; i++) {
+        CHECK(count[ids[i]] == 1);
+    }
+    CHECK(aoi_trigger_budget(aoi, 0, 1, count_trigger, count) == 1);
+    /** no limit, all watchers in one call, no event after first round */
+    memset(count, 0, sizeof count);
+    n = aoi_trigger_budget(aoi, 0, 0, count_trigger, count);
+    CHECK(n == 9);
+    for (i = 0; i < 10; i++) {
+        CHECK(count[ids[i]] == 0);
+    }
+    free_aoi(aoi);
+}
+
+static void
+setup_grid(struct aoi *aoi, int *ids, int n) {
+    aoi_grid(aoi, 50, 0);
+}
+
+/**
+ * Grid with tiny cell, queries of a far object make tune grow cell, then
+ * the rebuild is left half done, objects are in both grid.
+ */
+static void
+setup_grid_rebuild(struct aoi *aoi, int *ids, int n) {
+    int far = enter_at(aoi, 100000, 100000);
+    struct aoi_event *list;
+    int i;
+    aoi_grid(aoi, 20, AOI_GRID_AUTO);
+    for (i = 0; i < 2000; i++) {
+        aoi_trigger(aoi, far, 100, 130, &list);
+    }
+    aoi_leave(aoi, far);
+    /** first update start rebuild, each next one move n / AOI_GRID_STEP */
+    for (i = 0; i < 4; i++) {
+        aoi_update_all(aoi, 0);
+    }
+}
+
+static void
+setup_attach(struct aoi *aoi, int *ids, int n) {
+    int i;
+    for (i = 1; i < n; i += 4) {
+        aoi_attach(aoi, ids[i], ids[i - 1], 10, -10);
+    }
+}
+
+static void
+test_grid(void) {
+    check_same(300, 20, NULL, setup_grid);
+    check_same(300, 20, NULL, setup_grid_rebuild);
+    check_same(300, 20, setup_attach, setup_grid);
+}
+
+static void
+setup_group(struct aoi *aoi, int *ids, int n) {
+    int i;
+    for (i = 1; i < n; i += 3) {
+        aoi_group(aoi, ids[i], ids[i - 1]);
+    }
+}
+
+static void
+test_group(void) {
+    check_same(300, 20, NULL, setup_group);
+}
+
+static void
+test_attach(void) {
+    struct aoi *aoi = new_aoi();
+    int w = enter_at(aoi, 0, 0);
+    int p = enter_at(aoi, 300, 0);
+    int c = enter_at(aoi, 0, 0);
+    int x, y;
+    aoi_attach(aoi, c, p, 5, 5);
+    aoi_pos(aoi, c, &x, &y);
+    CHECK(x == 305 && y == 5);
+    CHECK(event_of(aoi, w, 100, 130, c) == 0);
+    aoi_locate(aoi, p, 50, 0);
+    aoi_pos(aoi, c, &x, &y);
+    CHECK(x == 55 && y == 5);
+    CHECK(event_of(aoi, w, 100, 130, c) == AOI_ENTER);
+    /** attached object see others from its own place */
+    CHECK(event_of(aoi, c, 100, 130, w) == AOI_ENTER);
+    aoi_attach(aoi, c, -1, 0, 0);
+    aoi_locate(aoi, p, 500, 0);
+    aoi_pos(aoi, c, &x, &y);
+    CHECK(x == 55 && y == 5);
+    CHECK(event_of(aoi, w, 100, 130, c) == 0);
+    free_aoi(aoi);
+}
+
+static void
+test_visible(void) {
+    struct aoi *aoi = new_aoi();
+    int w = enter_at(aoi, 0, 0);
+    int b = enter_at(aoi, 300, 0);
+    CHECK(event_of(aoi, w, 100, 130, b) == 0);
+    /** seen inside radius of target */
+    aoi_visible(aoi, b, 350);
+    CHECK(event_of(aoi, w, 100, 130, b) == AOI_ENTER);
+    /** leave radius of target add 30 of watcher */
+    aoi_locate(aoi, b, 370, 0);
+    CHECK(event_of(aoi, w, 100, 130, b) == 0);
+    aoi_locate(aoi, b, 390, 0);
+    CHECK(event_of(aoi, w, 100, 130, b) == AOI_LEAVE);
+    aoi_locate(aoi, b, 300, 0);
+    CHECK(event_of(aoi, w, 100, 130, b) == AOI_ENTER);
+    /** removed, seen by radius of watcher only */
+    aoi_visible(aoi, b, 0);
+    CHECK(event_of(aoi, w, 100, 130, b) == AOI_LEAVE);
+    aoi_visible(aoi, b, 350);
+    CHECK(event_of(aoi, w, 100, 130, b) == AOI_ENTER);
+    aoi_leave(aoi, b);
+    CHECK(event_of(aoi, w, 100, 130, b) == AOI_LEAVE);
+    free_aoi(aoi);
+}
+
+static void
+setup_spectator(struct aoi *aoi, int *ids, int n) {
+    int i;
+    for (i = 0; i < n; i += 5) {
+        aoi_spectator(aoi, ids[i], 1);
+    }
+}
+
+static void
+test_spectator(void) {
+    check_same(300, 20, NULL, setup_spectator);
+}
+
+/** Spectator test only changed objects, change of visible radius too. */
+static void
+test_visible_spectator(void) {
+    struct aoi *aoi = new_aoi();
+    int w = enter_at(aoi, 0, 0);
+    int b = enter_at(aoi, 300, 0);
+    aoi_spectator(aoi, w, 1);
+    CHECK(event_of(aoi, w, 100, 130, b) == 0);
+    aoi_visible(aoi, b, 350);
+    CHECK(event_of(aoi, w, 100, 130, b) == AOI_ENTER);
+    aoi_visible(aoi, b, 200);
+    CHECK(event_of(aoi, w, 100, 130, b) == AOI_LEAVE);
+    aoi_visible(aoi, b, 350);
+    CHECK(event_of(aoi, w, 100, 130, b) == AOI_ENTER);
+    aoi_visible(aoi, b, 0);
+    CHECK(event_of(aoi, w, 100, 130, b) == AOI_LEAVE);
+    free_aoi(aoi);
+}
+
+static void
+test_change_log(void) {
+    struct aoi *aoi = new_aoi();
+    struct aoi_change list[16];
+    unsigned cursor = aoi_change_log(aoi, 1), first, second;
+    int a = enter_at(aoi, 0, 0);
+    int n;
+    aoi_locate(aoi, a, 10, 0);
+    aoi_locate(aoi, a, 20, 0);
+    /** move of object not read yet is logged once */
+    n = aoi_changes(aoi, &cursor, list, 16);
+    CHECK(n == 1);
+    CHECK(list[0].id == a && list[0].e == AOI_CHANGE_ENTER);
+    aoi_locate(aoi, a, 30, 0);
+    aoi_leave(aoi, a);
+    n = aoi_changes(aoi, &cursor, list, 16);
+    CHECK(n == 2);
+    CHECK(list[0].id == a && list[0].e == AOI_CHANGE_MOVE);
+    CHECK(list[1].id == a && list[1].e == AOI_CHANGE_LEAVE);
+    CHECK(aoi_changes(aoi, &cursor, list, 16) == 0);
+    aoi_change_log(aoi, 0);
+    free_aoi(aoi);
+
+    /** new reader after move not read yet, both see next move */
+    aoi = new_aoi();
+    first = aoi_change_log(aoi, 1);
+    a = enter_at(aoi, 0, 0);
+    second = aoi_change_log(aoi, 1);
+    aoi_locate(aoi, a, 10, 0);
+    CHECK(aoi_changes(aoi, &first, list, 16) == 2);
+    n = aoi_changes(aoi, &second, list, 16);
+    CHECK(n == 1 && list[0].id == a && list[0].e == AOI_CHANGE_MOVE);
+    /** log stay on until all readers off */
+    aoi_change_log(aoi, 0);
+    aoi_locate(aoi, a, 20, 0);
+    CHECK(aoi_changes(aoi, &second, list, 16) == 1);
+    aoi_change_log(aoi, 0);
+    aoi_locate(aoi, a, 30, 0);
+    CHECK(aoi_changes(aoi, &second, list, 16) == 0);
+    free_aoi(aoi);
+}
+
+/**
+ * Take only first event of iterator, the rest come out in next trigger,
+ * by x axis list or by change log of spectator.
+ */
+static void
+check_iter_stop(int spectator) {
+    struct aoi *aoi = new_aoi();
+    int w = enter_at(aoi, 0, 0);
+    int a = enter_at(aoi, 10, 0);
+    int b = enter_at(aoi, 20, 0);
+    struct aoi_iter it;
+    struct aoi_event e;
+    aoi_spectator(aoi, w, spectator);
+    CHECK(aoi_trigger_begin(aoi, w, 100, 130, &it) == 0);
+    CHECK(aoi_trigger_next(aoi, &it, &e) && e.id == a && e.e == AOI_ENTER);
+    aoi_trigger_end(aoi, &it);
+    CHECK(event_of(aoi, w, 100, 130, b) == AOI_ENTER);
+    CHECK(event_of(aoi, w, 100, 130, a) == 0);
+    /** leave taken, enter of the same trigger left */
+    aoi_locate(aoi, a, 500, 0);
+    aoi_locate(aoi, b, 500, 0);
+    aoi_trigger_begin(aoi, w, 100, 130, &it);
+    CHECK(aoi_trigger_next(aoi, &it, &e) && e.id == a && e.e == AOI_LEAVE);
+    aoi_trigger_end(aoi, &it);
+    CHECK(event_of(aoi, w, 100, 130, b) == AOI_LEAVE);
+    free_aoi(aoi);
+}
+
+static void
+test_iter(void) {
+    check_iter_stop(0);
+    check_iter_stop(1);
+}
+
+static void
+test_motion(void) {
+    struct aoi *aoi = new_aoi();
+    int a = enter_at(aoi, 0, 0);
+    int i, x, y;
+    float fx, fy;
+    aoi_speed(aoi, a, 10);
+    aoi_motion(aoi, a, AOI_MOTION_LINEAR);
+    aoi_move(aoi, a, 100, 0);
+    aoi_update_all(aoi, 3);
+    aoi_pos(aoi, a, &x, &y);
+    CHECK(x == 30 && y == 0);
+    /** profile change take effect from next move */
+    aoi_motion(aoi, a, AOI_MOTION_EASE);
+    aoi_update_all(aoi, 1);
+    aoi_pos(aoi, a, &x, &y);
+    CHECK(x == 40 && y == 0);
+    aoi_update_all(aoi, 6);
+    aoi_pos(aoi, a, &x, &y);
+    CHECK(x == 100 && y == 0 && !aoi_moving(aoi, a));
+    /** smoothstep, slow at start, half way at half time */
+    aoi_move(aoi, a, 200, 0);
+    aoi_update_all(aoi, 1);
+    aoi_pos(aoi, a, &x, &y);
+    CHECK(x == 102);
+    aoi_update_all(aoi, 4);
+    aoi_pos(aoi, a, &x, &y);
+    CHECK(x == 150);
+    aoi_update_all(aoi, 5);
+    aoi_pos(aoi, a, &x, &y);
+    CHECK(x == 200 && y == 0 && !aoi_moving(aoi, a));
+    /** wobble table follow sin^2 computed by sinf */
+    aoi_locate(aoi, a, 0, 0);
+    aoi_motion(aoi, a, AOI_MOTION_WOBBLE);
+    aoi_speed(aoi, a, 7);
+    aoi_move(aoi, a, 300, 400);
+    for (i = 1; i < 71; i++) {
+        float speed = (float)(7 << AOI_FRAC_BITS);
+        float c = (float)(500 << AOI_FRAC_BITS);
+        float e = 3.14159265f * speed / c;
+        float s = sinf(e * i) * sinf(e * i);
+        int ex = (int)(0.6f * speed * i - 0.6f * s * (1 << AOI_FRAC_BITS));
+        int ey = (int)(0.8f * speed * i + 0.8f * s * (1 << AOI_FRAC_BITS));
+        aoi_update_all(aoi, 1);
+        aoi_posf(aoi, a, &fx, &fy);
+        CHECK(abs((int)(fx * (1 << AOI_FRAC_BITS)) - ex) <= 1);
+        CHECK(abs((int)(fy * (1 << AOI_FRAC_BITS)) - ey) <= 1);
+    }
+    aoi_update_all(aoi, 1);
+    aoi_pos(aoi, a, &x, &y);
+    CHECK(x == 300 && y == 400 && !aoi_moving(aoi, a));
+    free_aoi(aoi);
+}
+
+static void
+test_arrival(void) {
+    struct aoi *aoi = new_aoi();
+    int a = enter_at(aoi, 0, 0);
+    int b = enter_at(aoi, 0, 0);
+    struct aoi_arrival *list;
+    aoi_speed(aoi, a, 10);
+    aoi_speed(aoi, b, 10);
+    aoi_update_all(aoi, 2);
+    CHECK(aoi_arrivals(aoi, &list) == 0);
+    aoi_move(aoi, a, 35, 0);
+    aoi_move(aoi, b, 0, 75);
+    /** tick of arrival inside the update, not the end of it */
+    aoi_update_all(aoi, 5);
+    CHECK(aoi_arrivals(aoi, &list) == 1);
+    CHECK(list[0].id == a && list[0].tick == 2 + 3);
+    aoi_update_all(aoi, 1);
+    CHECK(aoi_arrivals(aoi, &list) == 0);
+    aoi_update_all(aoi, 4);
+    CHECK(aoi_arrivals(aoi, &list) == 1);
+    CHECK(list[0].id == b && list[0].tick == 2 + 7);
+    /** list only hold arrivals of the last update */
+    aoi_update_all(aoi, 1);
+    CHECK(aoi_arrivals(aoi, &list) == 0);
+    free_aoi(aoi);
+}
+
+static void
+test_velocity(void) {
+    struct aoi *aoi = new_aoi();
+    int a = enter_at(aoi, 0, 0);
+    int w = enter_at(aoi, 250, 100);
+    int x, y;
+    aoi_set_velocity(aoi, a, 2, 1);
+    aoi_update_all(aoi, 10);
+    aoi_pos(aoi, a, &x, &y);
+    CHECK(x == 20 && y == 10);
+    CHECK(!aoi_moving(aoi, a));
+    aoi_update_all(aoi, 100);
+    CHECK(event_of(aoi, w, 100, 130, a) == AOI_ENTER);
+    aoi_set_velocity(aoi, a, 0, 0);
+    aoi_update_all(aoi, 10);
+    aoi_pos(aoi, a, &x, &y);
+    CHECK(x == 220 && y == 110);
+    /** attach stop velocity, object follow parent only */
+    aoi_set_velocity(aoi, a, 2, 1);
+    aoi_locate(aoi, w, 100, 100);
+    aoi_attach(aoi, a, w, 5, 5);
+    aoi_update_all(aoi, 10);
+    aoi_pos(aoi, a, &x, &y);
+    CHECK(x == 105 && y == 105);
+    aoi_set_velocity(aoi, w, 1, 0);
+    aoi_update_all(aoi, 10);
+    aoi_pos(aoi, a, &x, &y);
+    CHECK(x == 115 && y == 105);
+    free_aoi(aoi);
+}
+
+static void
+test_pairs(void) {
+    struct aoi *aoi = new_aoi();
+    struct aoi_pair list[64];
+    int pos[12][2], ids[12], i, j, k, n, brute = 0;
+    unsigned seed = 5;
+    for (i = 0; i < 12; i++) {
+        pos[i][0] = next_rand(&seed) % 60;
+        pos[i][1] = next_rand(&seed) % 60;
+        ids[i] = enter_at(aoi, pos[i][0], pos[i][1]);
+    }
+    /** attached objects paired at their own place */
+    for (i = 8; i < 12; i++) {
+        int p = ids[i - 8];
+        int px = pos[i - 8][0], py = pos[i - 8][1];
+        aoi_attach(aoi, ids[i], p, pos[i][0] - px, pos[i][1] - py);
+    }
+    for (i = 0; i < 12; i++) {
+        for (j = i + 1; j < 12; j++) {
+            int dx = pos[i][0] - pos[j][0], dy = pos[i][1] - pos[j][1];
+            brute += dx * dx + dy * dy <= 20 * 20;
+        }
+    }
+    n = aoi_pairs(aoi, 20, list, 64);
+    CHECK(n == brute);
+    for (k = 0; k < n && k < 64; k++) {
+        int a = list[k].a, b = list[k].b, dx, dy;
+        int ax, ay, bx, by;
+        aoi_pos(aoi, a, &ax, &ay);
+        aoi_pos(aoi, b, &bx, &by);
+        dx = ax - bx;
+        dy = ay - by;
+        CHECK(a != b && dx * dx + dy * dy <= 20 * 20);
+    }
+    /** total count tell list truncated */
+    CHECK(brute > 1 && aoi_pairs(aoi, 20, list, 1) == brute);
+    free_aoi(aoi);
+}
+
+static void
+test_frac(void) {
+#if AOI_FRAC_BITS > 0
+    struct aoi *aoi = new_aoi();
+    int a = enter_at(aoi, 0, 0);
+    float x, y, last = 0;
+    int i;
+    /** slower than one unit per tick, still moving every tick */
+    aoi_motion(aoi, a, AOI_MOTION_LINEAR);
+    aoi_speedf(aoi, a, 0.3f);
+    aoi_move(aoi, a, 10, 0);
+    for (i = 0; i < 10; i++) {
+        aoi_update_all(aoi, 1);
+        aoi_posf(aoi, a, &x, &y);
+        CHECK(x > last && y == 0);
+        last = x;
+    }
+    CHECK(aoi_moving(aoi, a));
+    CHECK(x > 2.9f && x < 3.1f);
+    /** fraction of 1/2^AOI_FRAC_BITS come back as is */
+    aoi_locatef(aoi, a, 12.25f, -3.5f);
+    aoi_posf(aoi, a, &x, &y);
+    CHECK(x == 12.25f && y == -3.5f);
+    free_aoi(aoi);
+#endif
+}
+
+int
+main(int argc, char *argv[]) {
+    test_trigger();
+    test_dwell();
+    test_dwell_spectator();
+    test_room();
+    test_shape();
+    test_pack();
+    test_pack_retry();
+    test_density();
+    test_shed();
+    test_budget();
+    test_grid();
+    test_group();
+    test_attach();
+    test_visible();
+    test_spectator();
+    test_visible_spectator();
+    test_change_log();
+    test_iter();
+    test_motion();
+    test_arrival();
+    test_velocity();
+    test_pairs();
+    test_frac();
+    if (failed) {
+        fprintf(stderr, "%d checks failed\n", failed);
+        return 1;
+    }
+    printf("all passed\n");
+    return 0;
+}